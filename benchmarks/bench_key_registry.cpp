@@ -0,0 +1,49 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "krypto/krypto.h"
+#include "krypto/key_registry.h"
+#include "test_keys.h"
+
+using crypto::key_registry;
+
+// Insert and lookup cost per key with a large peer table.
+int main()
+{
+    using clock = std::chrono::steady_clock;
+    using ns = std::chrono::nanoseconds;
+
+    const size_t count = 300000;
+    std::vector<std::shared_ptr<blob_key>> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(std::make_shared<blob_key>());
+    }
+
+    key_registry registry;
+    auto start = clock::now();
+    for (auto const& k : keys) {
+        registry.insert(k);
+    }
+    auto inserted = clock::now();
+    size_t hits = 0;
+    for (auto const& k : keys) {
+        hits += registry.find(k->id()) == k;
+    }
+    auto looked_up = clock::now();
+
+    std::cout << count << " keys (" << hits << " found): insert "
+              << std::chrono::duration_cast<ns>(inserted - start).count() / count << " ns, find "
+              << std::chrono::duration_cast<ns>(looked_up - inserted).count() / count << " ns each"
+              << std::endl;
+}
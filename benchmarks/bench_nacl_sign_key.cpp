@@ -0,0 +1,55 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/sha256_hash.h"
+
+using crypto::nacl_sign_key;
+
+// Signature checks one at a time against verify_batch() on the shared pool.
+int main()
+{
+    const size_t count = 2000;
+    std::vector<std::unique_ptr<nacl_sign_key>> keys;
+    std::vector<byte_array> digests, signatures;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i < 10) {
+            keys.emplace_back(new nacl_sign_key);
+        }
+        digests.push_back(crypto::sha256::to_byte_array(
+            crypto::sha256::hash(byte_array("packet " + std::to_string(i)))));
+        signatures.push_back(keys[i % 10]->sign(digests.back()));
+    }
+
+    std::vector<nacl_sign_key::signed_digest> items(count);
+    for (size_t i = 0; i < count; ++i) {
+        items[i] = { keys[i % 10].get(), &digests[i], &signatures[i], false };
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        keys[i % 10]->verify(digests[i], signatures[i]);
+    }
+    std::chrono::duration<double> single = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    nacl_sign_key::verify_batch(items.data(), count);
+    std::chrono::duration<double> batch = std::chrono::steady_clock::now() - start;
+
+    std::cout << "one by one: " << int(count / single.count()) << " verifies/s" << std::endl;
+    std::cout << "batch:      " << int(count / batch.count()) << " verifies/s on "
+              << crypto::thread_pool::shared().concurrency() << " threads" << std::endl;
+}
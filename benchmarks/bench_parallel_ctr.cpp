@@ -0,0 +1,45 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "krypto/krypto.h"
+#include "krypto/aes_256_ctr.h"
+#include "krypto/parallel_ctr.h"
+
+// A 64 MiB buffer through aes_256_ctr, serially and split over the shared pool.
+int main()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::vector<char> key(crypto::aes_256_ctr::key_size);
+    crypto::block iv;
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+    crypto::aes_256_ctr aes(byte_array(key.data(), key.size()));
+
+    std::vector<unsigned char> data(64 << 20);
+    crypto::fill_random(data);
+
+    auto start = clock::now();
+    aes.encrypt(data.data(), data.data(), data.size(), iv.data());
+    auto serial = clock::now() - start;
+
+    start = clock::now();
+    crypto::parallel_ctr::encrypt(aes, data.data(), data.data(), data.size(), iv.data());
+    auto parallel = clock::now() - start;
+
+    auto mbps = [&](clock::duration d) {
+        return data.size() / std::chrono::duration<double, std::micro>(d).count();
+    };
+    std::cout << "64 MiB aes_256_ctr, serial:    " << mbps(serial) << " MB/s" << std::endl;
+    std::cout << "64 MiB aes_256_ctr, " << crypto::thread_pool::shared().concurrency()
+              << " threads: " << mbps(parallel) << " MB/s" << std::endl;
+}
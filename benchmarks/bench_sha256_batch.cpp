@@ -0,0 +1,45 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/sha256_hash.h"
+
+using namespace crypto::dispatch;
+
+// Hashnames: SHA-256 of a short public key blob, many at once, per multi-buffer kernel.
+int main()
+{
+    const size_t count = 4096;
+    const int rounds = 20;
+    std::vector<byte_array> messages;
+    for (size_t i = 0; i < count; ++i)
+    {
+        byte_array m;
+        m.resize(94);
+        crypto::fill_random(m.as_vector());
+        messages.push_back(m);
+    }
+
+    for (impl i : { impl::portable, impl::avx2, impl::avx512 })
+    {
+        if (!force(primitive::sha256_batch, i)) {
+            continue;
+        }
+        auto start = std::chrono::steady_clock::now();
+        for (int round = 0; round < rounds; ++round) {
+            crypto::sha256::hash_batch(messages);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name(i) << ": " << int(rounds * count / elapsed.count()) << " hashes/s" << std::endl;
+    }
+}
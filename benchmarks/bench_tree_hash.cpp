@@ -0,0 +1,36 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "krypto/krypto.h"
+#include "krypto/thread_pool.h"
+#include "krypto/tree_hash.h"
+
+using namespace crypto;
+
+// Tree hash of a large buffer on the shared pool against a single SHA-256 pass.
+int main()
+{
+    std::vector<unsigned char> data(64 << 20);
+    fill_random(data);
+
+    auto start = std::chrono::steady_clock::now();
+    sha256::hash(data.data(), data.size());
+    std::chrono::duration<double> serial = std::chrono::steady_clock::now() - start;
+
+    start = std::chrono::steady_clock::now();
+    tree_hash::hash(data.data(), data.size());
+    std::chrono::duration<double> tree = std::chrono::steady_clock::now() - start;
+
+    std::cout << "64 MiB sha256:    " << int(data.size() / serial.count() / 1e6) << " MB/s" << std::endl;
+    std::cout << "64 MiB tree hash: " << int(data.size() / tree.count() / 1e6) << " MB/s on "
+              << thread_pool::shared().concurrency() << " threads" << std::endl;
+}
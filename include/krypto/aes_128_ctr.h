@@ -8,6 +8,10 @@
 //
 #pragma once
 
+#include <crypto_stream_aes128ctr.h>
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/packet.h"
 #include "arsenal/byte_array.h"
 
 namespace crypto {
@@ -17,11 +21,21 @@ namespace crypto {
  */
 class aes_128_ctr
 {
-    std::string key_;
+    /// Expanded (bitsliced) key, computed once by crypto_stream_aes128ctr_beforenm().
+    alignas(16) unsigned char key_schedule_[crypto_stream_aes128ctr_BEFORENMBYTES];
+    alignas(16) unsigned char round_keys_[11 * 16]; ///< AES-NI key schedule.
+    dispatch::impl impl_;                           ///< Kernel bound at construction.
 
 public:
+    enum {
+        key_size   = crypto_stream_aes128ctr_KEYBYTES,
+        iv_size    = crypto_stream_aes128ctr_NONCEBYTES,
+        block_size = 16  ///< AES block size, the keystream granularity.
+    };
+
     /**
      * Construct AES-128 cipher and set the @a key.
+     * The key schedule is expanded here once, encryption only generates keystream.
      */
     aes_128_ctr(byte_array const& key);
     ~aes_128_ctr();
@@ -34,6 +48,76 @@ public:
      */
     byte_array encrypt(byte_array const& in, std::string iv);
 
+    /**
+     * Encrypt in counter mode with IV in any container accepted by boost::asio::buffer().
+     */
+    template <typename V>
+    byte_array encrypt(byte_array const& in, V const& iv)
+    {
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(v.len == iv_size);
+        byte_array out;
+        out.resize(in.size());
+        encrypt((unsigned char const*)in.const_data(), (unsigned char*)out.data(), in.size(), v.ptr);
+        return out;
+    }
+
+    /**
+     * Encrypt in counter mode into a caller-owned buffer. Does not allocate.
+     * @a in and @a out must either be the same pointer (in-place) or not overlap.
+     * @param  in      Source data, @a size bytes.
+     * @param  out     Destination buffer, at least @a size bytes.
+     * @param  size    Number of bytes to process.
+     * @param  iv      Initialization vector, iv_size bytes.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv) const;
+
+    /**
+     * Encrypt in counter mode, starting the keystream at block @a ic instead of block 0.
+     * Byte offset @a ic * block_size of a message can be processed independently this way.
+     * The counter occupies the last 32 bits of the IV in big-endian order and wraps
+     * around without carrying into the rest of the IV, the same as libsodium does.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv, uint64_t ic) const;
+
+    /**
+     * Encrypt a batch of independent packets under this key.
+     * Each packet's ok flag is set to tell whether it was processed; packets with
+     * a null IV or unusable buffers are skipped. With AES-NI the blocks of
+     * different packets are interleaved to keep the AES pipeline full.
+     * @return Number of packets processed.
+     */
+    size_t encrypt(packet* packets, size_t count) const;
+
+    /**
+     * Encrypt between caller-owned containers (anything boost::asio::buffer() accepts).
+     * @a out must be at least as large as @a in.
+     */
+    template <typename I, typename O, typename V>
+    void encrypt(I const& in, O& out, V const& iv) const
+    {
+        internal::raw<unsigned char const*> i(boost::asio::buffer(in));
+        internal::raw<unsigned char*> o(boost::asio::buffer(out));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(o.len >= i.len);
+        assert(v.len == iv_size);
+        encrypt(i.ptr, o.ptr, i.len, v.ptr);
+    }
+
+    /**
+     * Encrypt the contents of @a data in place.
+     */
+    template <typename C, typename V>
+    void encrypt_in_place(C& data, V const& iv) const
+    {
+        internal::raw<unsigned char*> d(boost::asio::buffer(data));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(v.len == iv_size);
+        encrypt(d.ptr, d.ptr, d.len, v.ptr);
+    }
+
     /**
      * Decrypt in counter mode.
      * @param  in      Block of encrypted data.
@@ -43,6 +127,35 @@ public:
     inline byte_array decrypt(byte_array const& in, std::string iv) {
         return encrypt(in, iv);
     }
+
+    template <typename V>
+    inline byte_array decrypt(byte_array const& in, V const& iv) {
+        return encrypt(in, iv);
+    }
+
+    inline void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                        unsigned char const* iv) const {
+        encrypt(in, out, size, iv);
+    }
+
+    inline void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                        unsigned char const* iv, uint64_t ic) const {
+        encrypt(in, out, size, iv, ic);
+    }
+
+    inline size_t decrypt(packet* packets, size_t count) const {
+        return encrypt(packets, count);
+    }
+
+    template <typename I, typename O, typename V>
+    inline void decrypt(I const& in, O& out, V const& iv) const {
+        encrypt(in, out, iv);
+    }
+
+    template <typename C, typename V>
+    inline void decrypt_in_place(C& data, V const& iv) const {
+        encrypt_in_place(data, iv);
+    }
 };
 
 } // crypto namespace
@@ -6,19 +6,29 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
-// Not used with NaCl?
+// Not used with NaCl, kept for interoperability with legacy peers.
 //
 #pragma once
 
-// #include <openssl/aes.h>
+#include <mutex>
+#include <boost/noncopyable.hpp>
+#include <openssl/evp.h>
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/packet.h"
 #include "arsenal/byte_array.h"
 
 namespace crypto {
 
-class aes_256_cbc
+/**
+ * AES-CBC block cipher, 256-bit keys (128 and 192 bits are accepted too).
+ *
+ * An instance is keyed for one direction only. Decryption keeps eight blocks
+ * in flight; encryption is serial per message, so encrypt several independent
+ * messages at once with the packet batch overload to fill the pipeline.
+ */
+class aes_256_cbc : boost::noncopyable
 {
-    // AES_KEY key_;
-
 public:
     enum class type
     {
@@ -26,12 +36,66 @@ public:
         decrypt
     };
 
+private:
+    type which_;
+    EVP_CIPHER_CTX* keyed_;                         ///< Keyed once and never run, portable path.
+    EVP_CIPHER_CTX* context_;                       ///< Copy of keyed_ reused by each call.
+    mutable std::mutex context_lock_;               ///< Held while a call uses context_.
+    alignas(16) unsigned char round_keys_[15 * 16]; ///< AES-NI schedule for this direction.
+    int rounds_;
+    dispatch::impl impl_;                           ///< Kernel bound at construction.
+
+    void run_portable(unsigned char const* in, unsigned char* out, size_t size,
+                      unsigned char const* iv) const;
+
+public:
+    enum {
+        key_size   = 32,
+        iv_size    = 16,
+        block_size = 16
+    };
+
     aes_256_cbc(type which, byte_array const& key);
+    ~aes_256_cbc();
 
-    // Encrypted data is padded to AES_BLOCK_SIZE.
+    /**
+     * Encrypt with a random IV.
+     * @return IV followed by the encrypted data, zero-padded to block_size.
+     */
     byte_array encrypt(byte_array const& in);
-    // Decrypted data padding is not stripped.
+
+    /**
+     * Decrypt data produced by encrypt(byte_array const&): IV followed by ciphertext.
+     * @return Decrypted data, padding is not stripped. Empty if @a in is malformed.
+     */
     byte_array decrypt(byte_array const& in);
+
+    /**
+     * Encrypt @a size bytes, a multiple of block_size, into a caller-owned buffer.
+     * @a in and @a out must either be the same pointer (in-place) or not overlap.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv) const;
+
+    /**
+     * Decrypt @a size bytes, a multiple of block_size, into a caller-owned buffer.
+     * @a in and @a out must either be the same pointer (in-place) or not overlap.
+     */
+    void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv) const;
+
+    /**
+     * Encrypt a batch of independent messages, interleaving their CBC chains.
+     * Packets with a null IV, unusable buffers or a size that is not a multiple
+     * of block_size are skipped with ok cleared.
+     * @return Number of packets processed.
+     */
+    size_t encrypt(packet* packets, size_t count) const;
+
+    /**
+     * Decrypt a batch of independent messages; same rules as for encryption.
+     */
+    size_t decrypt(packet* packets, size_t count) const;
 };
 
 } // crypto namespace
@@ -0,0 +1,169 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <mutex>
+#include <openssl/evp.h>
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/packet.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * AES-256-CTR stream cipher, as used for telehash open and line packets.
+ *
+ * The whole 16-byte IV is the initial counter block and is incremented as a
+ * 128-bit big-endian number, compatible with OpenSSL and NIST SP 800-38A.
+ * Uses AES-NI (and VAES on 512-bit registers for bulk data) when the CPU has it,
+ * OpenSSL's EVP AES-256-CTR otherwise.
+ */
+class aes_256_ctr
+{
+    EVP_CIPHER_CTX* keyed_;                         ///< Keyed once and never run, portable path.
+    EVP_CIPHER_CTX* context_;                       ///< Copy of keyed_ reused by encrypt().
+    mutable std::mutex context_lock_;               ///< Held while a call uses context_.
+    alignas(16) unsigned char round_keys_[15 * 16]; ///< AES-NI key schedule.
+    dispatch::impl impl_;                           ///< Kernel bound at construction.
+
+public:
+    enum {
+        key_size   = 32,
+        iv_size    = 16,
+        block_size = 16  ///< AES block size, the keystream granularity.
+    };
+
+    /**
+     * Construct AES-256 cipher and set the @a key.
+     * The key schedule is expanded here once, encryption only generates keystream.
+     */
+    aes_256_ctr(byte_array const& key);
+    aes_256_ctr(aes_256_ctr const& other);
+    ~aes_256_ctr();
+
+    aes_256_ctr& operator =(aes_256_ctr const&) = delete;
+
+    /**
+     * Encrypt in counter mode.
+     * @param  in      Block of data.
+     * @param  iv      Initialization vector.
+     * @return         Encrypted data.
+     */
+    byte_array encrypt(byte_array const& in, std::string iv);
+
+    /**
+     * Encrypt in counter mode with IV in any container accepted by boost::asio::buffer().
+     */
+    template <typename V>
+    byte_array encrypt(byte_array const& in, V const& iv)
+    {
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(v.len == iv_size);
+        byte_array out;
+        out.resize(in.size());
+        encrypt((unsigned char const*)in.const_data(), (unsigned char*)out.data(), in.size(), v.ptr);
+        return out;
+    }
+
+    /**
+     * Encrypt in counter mode into a caller-owned buffer. Does not allocate.
+     * @a in and @a out must either be the same pointer (in-place) or not overlap.
+     * @param  in      Source data, @a size bytes.
+     * @param  out     Destination buffer, at least @a size bytes.
+     * @param  size    Number of bytes to process.
+     * @param  iv      Initialization vector, iv_size bytes.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv) const;
+
+    /**
+     * Encrypt in counter mode, starting the keystream at block @a ic instead of block 0.
+     * Byte offset @a ic * block_size of a message can be processed independently this way.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv, uint64_t ic) const;
+
+    /**
+     * Encrypt a batch of independent packets under this key.
+     * Each packet's ok flag is set to tell whether it was processed; packets with
+     * a null IV or unusable buffers are skipped. With AES-NI the blocks of
+     * different packets are interleaved to keep the AES pipeline full.
+     * @return Number of packets processed.
+     */
+    size_t encrypt(packet* packets, size_t count) const;
+
+    /**
+     * Encrypt between caller-owned containers (anything boost::asio::buffer() accepts).
+     * @a out must be at least as large as @a in.
+     */
+    template <typename I, typename O, typename V>
+    void encrypt(I const& in, O& out, V const& iv) const
+    {
+        internal::raw<unsigned char const*> i(boost::asio::buffer(in));
+        internal::raw<unsigned char*> o(boost::asio::buffer(out));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(o.len >= i.len);
+        assert(v.len == iv_size);
+        encrypt(i.ptr, o.ptr, i.len, v.ptr);
+    }
+
+    /**
+     * Encrypt the contents of @a data in place.
+     */
+    template <typename C, typename V>
+    void encrypt_in_place(C& data, V const& iv) const
+    {
+        internal::raw<unsigned char*> d(boost::asio::buffer(data));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(v.len == iv_size);
+        encrypt(d.ptr, d.ptr, d.len, v.ptr);
+    }
+
+    /**
+     * Decrypt in counter mode.
+     * @param  in      Block of encrypted data.
+     * @param  iv      Initialization vector.
+     * @return         Decrypted data.
+     */
+    inline byte_array decrypt(byte_array const& in, std::string iv) {
+        return encrypt(in, iv);
+    }
+
+    template <typename V>
+    inline byte_array decrypt(byte_array const& in, V const& iv) {
+        return encrypt(in, iv);
+    }
+
+    inline void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                        unsigned char const* iv) const {
+        encrypt(in, out, size, iv);
+    }
+
+    inline void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                        unsigned char const* iv, uint64_t ic) const {
+        encrypt(in, out, size, iv, ic);
+    }
+
+    inline size_t decrypt(packet* packets, size_t count) const {
+        return encrypt(packets, count);
+    }
+
+    template <typename I, typename O, typename V>
+    inline void decrypt(I const& in, O& out, V const& iv) const {
+        encrypt(in, out, iv);
+    }
+
+    template <typename C, typename V>
+    inline void decrypt_in_place(C& data, V const& iv) const {
+        encrypt_in_place(data, iv);
+    }
+};
+
+} // crypto namespace
@@ -0,0 +1,129 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <openssl/evp.h>
+#include "krypto/krypto.h"
+
+namespace crypto {
+
+/**
+ * Authenticated encryption with associated data (AES-GCM), streaming.
+ *
+ * Encryption and authentication happen in the same pass over the data: feed the
+ * associated data first, then transform() the payload in chunks of any size into
+ * caller-provided buffers, then seal() (encrypt mode) or verify() (decrypt mode).
+ * The AES key size (128, 192 or 256 bits) follows the size of the key container.
+ *
+ *     crypto::cipher cipher(key, iv);          // encrypt mode
+ *     cipher.associate_data(header);
+ *     cipher.transform(plaintext, ciphertext);
+ *     cipher.seal(seal);
+ *
+ *     crypto::cipher cipher(key, iv, seal);    // decrypt mode
+ *     cipher.associate_data(header);
+ *     cipher.transform(ciphertext, plaintext);
+ *     cipher.verify();                         // throws std::runtime_error on forgery
+ *
+ * Plaintext produced in decrypt mode must not be trusted until verify() returns.
+ */
+class cipher : boost::noncopyable
+{
+    EVP_CIPHER_CTX* context_;
+    bool encrypting_;
+
+public:
+    enum {
+        seal_size = 16 ///< Size of the authentication tag.
+    };
+
+    /**
+     * Construct cipher in encrypt mode.
+     * @param key  AES key, 16, 24 or 32 bytes.
+     * @param iv   Initialization vector; must never repeat for the same key.
+     */
+    template <typename K, typename I>
+    cipher(K const& key, I const& iv)
+    {
+        internal::raw<unsigned char const*> k(boost::asio::buffer(key));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        init(k.ptr, k.len, v.ptr, v.len, true);
+    }
+
+    /**
+     * Construct cipher in decrypt mode, expecting the given @a seal.
+     * @throws std::runtime_error unless the seal is seal_size bytes.
+     */
+    template <typename K, typename I, typename S>
+    cipher(K const& key, I const& iv, S const& seal)
+    {
+        internal::raw<unsigned char const*> k(boost::asio::buffer(key));
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        internal::raw<unsigned char const*> s(boost::asio::buffer(seal));
+        init(k.ptr, k.len, v.ptr, v.len, false);
+        set_seal(s.ptr, s.len);
+    }
+
+    ~cipher();
+
+    /**
+     * Authenticate @a data without encrypting it. Must precede transform().
+     */
+    void associate_data(unsigned char const* data, size_t size);
+
+    template <typename T>
+    void associate_data(T const& data)
+    {
+        internal::raw<unsigned char const*> d(boost::asio::buffer(data));
+        associate_data(d.ptr, d.len);
+    }
+
+    /**
+     * Encrypt or decrypt the next @a size bytes. @a in and @a out may be the same pointer.
+     */
+    void transform(unsigned char const* in, unsigned char* out, size_t size);
+
+    /**
+     * Transform @a in into @a out, which must be at least as large.
+     */
+    template <typename I, typename O>
+    void transform(I const& in, O& out)
+    {
+        internal::raw<unsigned char const*> i(boost::asio::buffer(in));
+        internal::raw<unsigned char*> o(boost::asio::buffer(out));
+        assert(o.len >= i.len);
+        transform(i.ptr, o.ptr, i.len);
+    }
+
+    /**
+     * Finish encryption and write the authentication tag.
+     * @throws std::runtime_error unless @a size is seal_size.
+     */
+    void seal(unsigned char* seal, size_t size = seal_size);
+
+    template <typename S>
+    void seal(S& seal)
+    {
+        internal::raw<unsigned char*> s(boost::asio::buffer(seal));
+        this->seal(s.ptr, s.len);
+    }
+
+    /**
+     * Finish decryption and check the seal.
+     * @throws std::runtime_error if the data or associated data were tampered with.
+     */
+    void verify();
+
+private:
+    void init(unsigned char const* key, size_t key_size,
+              unsigned char const* iv, size_t iv_size, bool encrypt);
+    void set_seal(unsigned char const* seal, size_t size);
+};
+
+} // crypto namespace
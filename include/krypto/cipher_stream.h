@@ -0,0 +1,115 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <algorithm>
+#include "krypto/krypto.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * Seekable incremental encryption with a counter-mode stream cipher
+ * (aes_128_ctr or xsalsa20).
+ *
+ * The stream keeps the key and IV and a current byte offset into the keystream.
+ * Data may be fed in chunks of any size; the result is identical to encrypting
+ * the whole message at once. seek() repositions the keystream, so any byte range
+ * of a message can be encrypted or decrypted on its own, e.g. for retransmits.
+ */
+template <typename Cipher>
+class cipher_stream
+{
+    Cipher cipher_;
+    unsigned char iv_[Cipher::iv_size];
+    uint64_t offset_{0};
+
+public:
+    /**
+     * Construct the stream with @a key and @a iv, positioned at offset 0.
+     * @a iv can be any container accepted by boost::asio::buffer().
+     */
+    template <typename V>
+    cipher_stream(byte_array const& key, V const& iv)
+        : cipher_(key)
+    {
+        internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+        assert(v.len == Cipher::iv_size);
+        std::copy(v.ptr, v.ptr + Cipher::iv_size, iv_);
+    }
+
+    ~cipher_stream()
+    {
+        crypto::cleanse(iv_);
+    }
+
+    /**
+     * Current byte offset into the keystream.
+     */
+    inline uint64_t offset() const { return offset_; }
+
+    /**
+     * Reposition the keystream to byte @a offset of the message.
+     */
+    inline void seek(uint64_t offset) { offset_ = offset; }
+
+    /**
+     * Encrypt the next @a size bytes of the message and advance the offset.
+     * @a in and @a out must either be the same pointer (in-place) or not overlap.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size)
+    {
+        size_t skip = offset_ % Cipher::block_size;
+        if (skip != 0 and size != 0)
+        {
+            // Finish the partially consumed block through a scratch block.
+            unsigned char block[Cipher::block_size] = {0};
+            size_t n = std::min<size_t>(size, Cipher::block_size - skip);
+            std::copy(in, in + n, block + skip);
+            cipher_.encrypt(block, block, Cipher::block_size, iv_, offset_ / Cipher::block_size);
+            std::copy(block + skip, block + skip + n, out);
+            crypto::cleanse(block);
+            in += n;
+            out += n;
+            size -= n;
+            offset_ += n;
+        }
+        if (size != 0)
+        {
+            cipher_.encrypt(in, out, size, iv_, offset_ / Cipher::block_size);
+            offset_ += size;
+        }
+    }
+
+    /**
+     * Encrypt the next chunk from @a in into @a out (anything boost::asio::buffer() accepts).
+     */
+    template <typename I, typename O>
+    void encrypt(I const& in, O& out)
+    {
+        internal::raw<unsigned char const*> i(boost::asio::buffer(in));
+        internal::raw<unsigned char*> o(boost::asio::buffer(out));
+        assert(o.len >= i.len);
+        encrypt(i.ptr, o.ptr, i.len);
+    }
+
+    /**
+     * Decrypt the next @a size bytes of the message and advance the offset.
+     */
+    inline void decrypt(unsigned char const* in, unsigned char* out, size_t size) {
+        encrypt(in, out, size);
+    }
+
+    template <typename I, typename O>
+    inline void decrypt(I const& in, O& out) {
+        encrypt(in, out);
+    }
+};
+
+} // crypto namespace
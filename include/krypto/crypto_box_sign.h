@@ -8,31 +8,62 @@
 //
 #pragma once
 
-#include <crypto_box.h>
+#include <crypto_sign.h>
 #include "krypto/sign_key.h"
+#include "krypto/thread_pool.h"
 
 namespace crypto {
 
+/**
+ * Ed25519 signing key (libsodium crypto_sign).
+ *
+ * Keys serialise as public key, private key flag[, secret key] with flurry,
+ * the same layout as rsa160_key; public_key() output can be passed back to the
+ * constructor to get a verify-only key.
+ */
 class nacl_sign_key : public sign_key
 {
-    std::string sk;
-    std::string pk;
-
-    // nacl_sign_key(pk, sk)
+    byte_array sk;
+    byte_array pk;
 
 public:
+    enum {
+        public_key_size = crypto_sign_PUBLICKEYBYTES,
+        secret_key_size = crypto_sign_SECRETKEYBYTES,
+        signature_size  = crypto_sign_BYTES
+    };
+
+    /**
+     * One signature to check in verify_batch(); the pointers are owned by the caller.
+     */
+    struct signed_digest
+    {
+        nacl_sign_key const* key;
+        byte_array const* digest;
+        byte_array const* signature;
+        bool ok; ///< Set by verify_batch(): true if the signature is valid.
+    };
+
     nacl_sign_key(byte_array const& keys);
     nacl_sign_key(); // generate new
     ~nacl_sign_key();
 
-    byte_array id() const override;
-
-    byte_array public_key() const override;
     byte_array private_key() const override;
 
+    /// @throws std::runtime_error for a key without its private part.
     byte_array sign(byte_array const& digest) const override;
     bool verify(byte_array const& digest, byte_array const& signature) const override;
 
+    /**
+     * Verify a burst of signatures, spread over @a pool.
+     * @return Number of valid signatures.
+     */
+    static size_t verify_batch(signed_digest* items, size_t count,
+                               thread_pool& pool = thread_pool::shared());
+
+protected:
+    byte_array encode_public_key() const override;
+
 private:
     void dump() const;
 };
@@ -0,0 +1,136 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crypto {
+
+/**
+ * Runtime CPU feature dispatch for symmetric and hash kernels.
+ *
+ * CPUID is probed once per process and every primitive is bound to the best
+ * implementation the host supports. The choice can be overridden with the
+ * KRYPTO_IMPL environment variable, read at the same time, e.g.
+ *
+ *     KRYPTO_IMPL=portable                       force portable code everywhere
+ *     KRYPTO_IMPL=aes_256_ctr=aesni,sha256=shani force single primitives
+ *
+ * Implementations a host does not support are ignored with a warning.
+ * Cipher objects bind their kernel when constructed, hash calls on every call.
+ */
+namespace dispatch {
+
+/// CPU features relevant to libkrypto kernels.
+struct cpu_features
+{
+    bool sse41;
+    bool aesni;
+    bool pclmul;
+    bool avx2;
+    bool avx512f; ///< Including OS support for saving ZMM state.
+    bool vaes;    ///< VAES usable on 512-bit registers.
+    bool sha;     ///< SHA-NI extensions.
+};
+
+/// Features of this host, probed once.
+cpu_features const& cpu();
+
+enum class primitive
+{
+    aes_128_ctr,
+    aes_256_ctr,
+    aes_256_cbc,
+    xsalsa20,
+    sha256,
+    sha512,
+    sha256_batch  ///< Many independent messages at once.
+};
+
+enum class impl
+{
+    portable, ///< Plain C: libsodium, or OpenSSL EVP for aes_256_ctr/cbc.
+    openssl,  ///< OpenSSL EVP digests; opt-in only, their state lives on the heap.
+    aesni,    ///< In-house AES-NI kernels, eight blocks in flight.
+    vaes,     ///< AES-NI plus VAES on 512-bit registers for bulk data.
+    shani,    ///< In-house SHA-NI kernel.
+    avx2,     ///< Multi-buffer kernels, eight messages in 256-bit lanes.
+    avx512    ///< Multi-buffer kernels, sixteen messages in 512-bit lanes.
+};
+
+/// Implementation currently bound to primitive @a p.
+impl selected(primitive p);
+
+/// True if @a i can run primitive @a p on this host.
+bool supported(primitive p, impl i);
+
+/// Bind primitive @a p to implementation @a i, e.g. for benchmarks and tests.
+/// @return false (and no change) if this host cannot run @a i.
+bool force(primitive p, impl i);
+
+/// Human-readable implementation name: "portable", "openssl", "aesni", "vaes", "shani",
+/// "avx2" or "avx512".
+char const* name(impl i);
+
+/// Name of the implementation currently bound to @a p.
+inline char const* implementation(primitive p) { return name(selected(p)); }
+
+/**
+ * Hash kernel entry points operating on an opaque state of hash_state_size bytes.
+ *
+ * A state may hold resources (the OpenSSL kernel keeps an EVP_MD_CTX there), so
+ * every init() or copy() must be matched by discard(), and states are copied
+ * with copy(), never with memcpy.
+ */
+struct hash_kernel
+{
+    /// Start a hash in an uninitialised state.
+    void (*init)(void* state);
+    void (*update)(void* state, unsigned char const* data, size_t size);
+    /// Write the digest. The state keeps its resources until reset() or discard().
+    void (*final)(void* state, unsigned char* digest);
+    /// Start over in a live state, reusing its resources.
+    void (*reset)(void* state);
+    void (*hash)(unsigned char const* data, size_t size, unsigned char* digest);
+    /// Make @a to, uninitialised, an independent copy of @a from.
+    void (*copy)(void* to, void const* from);
+    /// Release the state without producing a digest.
+    void (*discard)(void* state);
+};
+
+/// Room for the largest hash state of any kernel.
+const size_t hash_state_size = 224;
+
+/// Kernels bound to sha256 and sha512.
+hash_kernel const& sha256();
+hash_kernel const& sha512();
+
+/**
+ * Hash @a count independent messages; digest i goes to @a digests + 32 * i.
+ */
+using hash_batch_kernel = void (*)(unsigned char const* const* data, size_t const* sizes,
+                                   size_t count, unsigned char* digests);
+
+/// Kernel bound to sha256_batch; the portable one runs sha256() on each message.
+hash_batch_kernel sha256_batch();
+
+/**
+ * Hash @a count messages that all continue from @a midstate, the eight SHA-256 state
+ * words after @a prefix bytes (a multiple of 64) were hashed, e.g. an HMAC key pad.
+ */
+using hash_batch_from_kernel = void (*)(uint32_t const* midstate, uint64_t prefix,
+                                        unsigned char const* const* data, size_t const* sizes,
+                                        size_t count, unsigned char* digests);
+
+/// Multi-buffer kernel bound to sha256_batch, or null when that is portable code.
+hash_batch_from_kernel sha256_batch_from();
+
+} // dispatch namespace
+} // crypto namespace
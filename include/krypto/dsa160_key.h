@@ -8,31 +8,88 @@
 //
 #pragma once
 
+#include <memory>
 #include <openssl/dsa.h>
 #include "krypto/sign_key.h"
 
 namespace crypto {
 
+class dsa_group;
+
+/**
+ * DSA key with 160-bit q and 160-bit id (SHA-256 of the public key, truncated).
+ *
+ * Signing can be split into an offline and an online part: with
+ * set_precompute() a low-priority thread keeps a pool of (k^-1, r) pairs,
+ * which costs the g^k mod p exponentiation, and sign() then only needs
+ * s = k^-1 (m + x r) mod q. When the pool is empty or off, sign() computes
+ * the pair itself. The online part is blinded the way OpenSSL's own DSA
+ * signing is, so x r mod q is never formed in the clear.
+ *
+ * Keys on one of the standard parameter sets share a dsa_group, whose
+ * Montgomery context and fixed-base table for g speed up key generation,
+ * pair setup and verification. Keys on other parameters use plain OpenSSL.
+ */
 class dsa160_key : public sign_key
 {
+    struct sign_pool;
+
     DSA* dsa_;
+    dsa_group const* group_{nullptr};  ///< Shared standard group, or nullptr.
+    std::unique_ptr<sign_pool> pool_;
 
     dsa160_key(DSA* dsa);
 
 public:
+    /// How many (k^-1, r) pairs to keep ready for sign().
+    struct precompute_config
+    {
+        size_t capacity;     ///< Pairs kept in the pool; 0 turns precomputation off.
+        size_t refill_below; ///< Refill starts when fewer pairs than this are left.
+    };
+
+    struct precompute_stats
+    {
+        uint64_t hits;       ///< Signatures made from a precomputed pair.
+        uint64_t misses;     ///< Signatures that had to compute their own.
+        size_t available;    ///< Pairs ready now.
+
+        inline double hit_rate() const {
+            return hits + misses ? double(hits) / double(hits + misses) : 0.0;
+        }
+    };
+
     dsa160_key(byte_array const& key);
     dsa160_key(int bits = 0);
     ~dsa160_key();
 
-    byte_array id() const override;
-
-    byte_array public_key() const override;
     byte_array private_key() const override;
 
+    /// Throws std::runtime_error for keys without a private part.
     byte_array sign(byte_array const& digest) const override;
     bool verify(byte_array const& digest, byte_array const& signature) const override;
 
+    /**
+     * Start, resize or (with capacity 0) stop the precomputed pair pool.
+     * Only meaningful for keys with a private part; must not race with sign().
+     */
+    void set_precompute(precompute_config const& config);
+
+    precompute_stats precompute_statistics() const;
+
+protected:
+    byte_array encode_public_key() const override;
+
+    // Only use 160 bits of the hash to produce the ID,
+    // because the cryptographic strength of the resulting ID
+    // is limited anyway by the 160-bit digest size, below.
+    // We're not using SHA-256 to get more than 160 bits of security,
+    // but in hopes it will withstand the recent attacks against SHA-1.
+    size_t id_size() const override { return 160/8; }
+
 private:
+    bool sign_setup(BN_CTX* ctx, BIGNUM** kinv, BIGNUM** r) const;
+    DSA_SIG* sign_online(byte_array const& digest, int digest_size, BIGNUM* kinv, BIGNUM* r) const;
     void dump() const;
 };
 
@@ -0,0 +1,75 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <openssl/bn.h>
+
+namespace crypto {
+
+/**
+ * DSA group (p, q, g) shared by every key built on it.
+ *
+ * The standard groups are created once per process and never change afterwards,
+ * so any number of keys and threads use them without locking. Besides the
+ * parameters a group keeps the Montgomery context for p and a fixed-base window
+ * table for g, which turns g^e into one Montgomery multiplication per 4 bits of
+ * e and no squarings. Table entries are picked in constant time.
+ */
+class dsa_group : boost::noncopyable
+{
+public:
+    static constexpr int window_bits = 4;
+    static constexpr unsigned window_size = 1u << window_bits;
+    /// Largest p supported, in 64-bit words.
+    static constexpr size_t words_max = 8192 / 64;
+
+    /// Standard group for @a bits long keys: 1024, 2048 or 3072. Nullptr for other sizes.
+    static dsa_group const* standard(int bits);
+
+    /// The standard group with these parameters, or nullptr if there is none.
+    static dsa_group const* find(BIGNUM const* p, BIGNUM const* q, BIGNUM const* g);
+
+    ~dsa_group();
+
+    inline BIGNUM const* p() const { return p_; }
+    inline BIGNUM const* q() const { return q_; }
+    inline BIGNUM const* g() const { return g_; }
+
+    /// r = g^e mod p.
+    bool pow_g(BIGNUM* r, BIGNUM const* e, BN_CTX* ctx) const;
+
+    /// New key pair: x random in [1, q), y = g^x mod p. Caller owns the results.
+    bool generate(BIGNUM** x, BIGNUM** y) const;
+
+    /// Offline part of a signature: random k, r = (g^k mod p) mod q, kinv = k^-1 mod q.
+    bool sign_setup(BN_CTX* ctx, BIGNUM** kinv, BIGNUM** r) const;
+
+    /// Check a signature (r, s) on the leading bytes of @a digest by public key @a y.
+    bool verify(unsigned char const* digest, int digest_size,
+                BIGNUM const* r, BIGNUM const* s, BIGNUM const* y) const;
+
+private:
+    BIGNUM* p_;
+    BIGNUM* q_;
+    BIGNUM* g_;
+    BN_MONT_CTX* mont_;
+    BIGNUM* one_;                       ///< 1 in Montgomery form.
+    size_t windows_;                    ///< Exponent windows covering q.
+    size_t width_;                      ///< Bytes per table entry.
+    std::vector<unsigned char> table_;  ///< g^(j 16^i) in Montgomery form, window i, entry j.
+
+    dsa_group(unsigned char const* p, size_t p_size, unsigned char const* q, size_t q_size,
+              unsigned char const* g, size_t g_size);
+
+    void select(size_t window, unsigned digit, unsigned char* out) const;
+};
+
+} // crypto namespace
@@ -0,0 +1,40 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <string>
+#include "krypto/sha256_hash.h"
+#include "krypto/sign_key.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * SHA-256 of the contents of file @a path.
+ *
+ * Regular files are mapped a window at a time, with read-ahead requested for
+ * the next window while the current one is hashed; anything that cannot be
+ * mapped (pipes, devices) is read in large aligned blocks instead. Memory use
+ * does not grow with the file size.
+ * @throws std::runtime_error if the file cannot be opened or read.
+ */
+sha256::digest hash_file(std::string const& path);
+
+/**
+ * Sign the SHA-256 of file @a path with @a key.
+ * @return Signature as produced by sign_key::sign().
+ */
+byte_array sign_file(sign_key const& key, std::string const& path);
+
+/**
+ * Check a signature made by sign_file().
+ */
+bool verify_file(sign_key const& key, std::string const& path, byte_array const& signature);
+
+} // crypto namespace
@@ -0,0 +1,74 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <memory>
+#include "krypto/sha256_hash.h"
+#include "krypto/hmac.h"
+
+namespace crypto {
+
+/**
+ * Message digest (SHA-256).
+ *
+ *     crypto::hash md;
+ *     crypto::hash::value sha;
+ *     md.update("hello world!");
+ *     md.update("see you world!");
+ *     md.finalize(sha);
+ *
+ * Constructed with a key it computes HMAC-SHA-256 instead (see crypto::hmac).
+ */
+class hash
+{
+    std::shared_ptr<hmac const> key_; ///< Shared between copies, never modified.
+    sha256::context context_;
+
+public:
+    /// The hash value.
+    using value = sha256::digest;
+
+    enum {
+        size = sha256::digest_size
+    };
+
+    hash() = default;
+
+    /**
+     * Keyed hash (MAC), key from any container accepted by boost::asio::buffer().
+     */
+    template <typename K>
+    explicit hash(K const& key)
+        : key_(std::make_shared<hmac>(key))
+        , context_(key_->begin())
+    {}
+
+    /**
+     * Add data: a NUL-terminated string, a byte_array, or any container
+     * accepted by boost::asio::buffer().
+     */
+    template <typename T>
+    void update(T const& data) { context_.update(data); }
+
+    inline void update(unsigned char const* data, size_t size) { context_.update(data, size); }
+
+    /**
+     * Get the digest of all data added; the object is then ready for a new message.
+     */
+    inline void finalize(value& out)
+    {
+        if (key_) {
+            key_->finalize(context_, out.data());
+        } else {
+            context_.finalize(out);
+        }
+    }
+};
+
+} // crypto namespace
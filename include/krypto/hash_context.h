@@ -0,0 +1,136 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <cstring>
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * Incremental hash with an N-byte digest, on the kernel @a Kernel returns.
+ * Used as sha256::context and sha512::context.
+ *
+ * Contexts may be copied to fork a hash over a common prefix.
+ * After finalize() the context starts over with the next update and can be reused.
+ */
+template <size_t N, dispatch::hash_kernel const& (*Kernel)()>
+class basic_context
+{
+    alignas(16) unsigned char state_[dispatch::hash_state_size];
+    dispatch::hash_kernel const* kernel_;
+    bool finished_; ///< finalize() ran; restart before the next use.
+
+    inline void restart()
+    {
+        if (finished_) {
+            kernel_->reset(state_);
+            finished_ = false;
+        }
+    }
+
+public:
+    /// Fixed-size digest, lives on the stack.
+    using digest = boost::array<unsigned char, N>;
+
+    basic_context()
+        : kernel_(&Kernel())
+        , finished_(false)
+    {
+        kernel_->init(state_);
+    }
+
+    basic_context(basic_context const& other)
+        : kernel_(other.kernel_)
+        , finished_(other.finished_)
+    {
+        kernel_->copy(state_, other.state_);
+    }
+
+    basic_context& operator =(basic_context const& other)
+    {
+        if (this != &other)
+        {
+            kernel_->discard(state_);
+            kernel_ = other.kernel_;
+            finished_ = other.finished_;
+            kernel_->copy(state_, other.state_);
+        }
+        return *this;
+    }
+
+    ~basic_context()
+    {
+        kernel_->discard(state_);
+        crypto::cleanse(state_);
+    }
+
+    /**
+     * Start over, discarding all data hashed so far.
+     */
+    inline void reset()
+    {
+        kernel_->reset(state_);
+        finished_ = false;
+    }
+
+    inline void update(unsigned char const* data, size_t size)
+    {
+        restart();
+        kernel_->update(state_, data, size);
+    }
+
+    inline void update(char const* data, size_t size) {
+        update((unsigned char const*)data, size);
+    }
+
+    /**
+     * Add a NUL-terminated string, without the terminator.
+     */
+    inline void update(char const* text) {
+        update(text, std::strlen(text));
+    }
+
+    inline void update(byte_array const& data) {
+        update(data.const_data(), data.size());
+    }
+
+    /**
+     * Add the contents of any container accepted by boost::asio::buffer().
+     */
+    template <typename T>
+    void update(T const& data)
+    {
+        internal::raw<unsigned char const*> d(boost::asio::buffer(data));
+        update(d.ptr, d.len);
+    }
+
+    /**
+     * Write the digest (N bytes) to @a out and reset the context.
+     */
+    inline void finalize(unsigned char* out)
+    {
+        restart();
+        kernel_->final(state_, out);
+        finished_ = true;
+    }
+
+    inline void finalize(digest& out) { finalize(out.data()); }
+
+    inline digest finalize()
+    {
+        digest out;
+        finalize(out.data());
+        return out;
+    }
+};
+
+} // crypto namespace
@@ -0,0 +1,124 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <cstdint>
+#include "krypto/krypto.h"
+#include "krypto/sha256_hash.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * HMAC-SHA-256-128 (RFC 2104, tag truncated to 128 bits as in RFC 4868).
+ *
+ * The key is folded into the SHA-256 state of the inner (key ^ ipad) and outer
+ * (key ^ opad) hashes once, at construction. A MAC then costs the message blocks
+ * plus one more compression for the outer hash, and the object can be shared
+ * between threads since sign() and verify() leave it untouched.
+ *
+ *     crypto::hmac mac(line_key);
+ *     crypto::hmac::tag t = mac.sign(packet);
+ *     if (!mac.verify(packet, t)) ...
+ */
+class hmac
+{
+    sha256::context inner_; ///< Has absorbed key ^ ipad.
+    sha256::context outer_; ///< Has absorbed key ^ opad.
+    uint32_t inner_mid_[8]; ///< Raw state words of inner_, for the multi-buffer kernels.
+    uint32_t outer_mid_[8]; ///< Raw state words of outer_.
+
+    /// HMAC of the data in @a ctx, leaving @a ctx finished.
+    void finish(sha256::context& ctx, unsigned char* out) const;
+
+public:
+    enum {
+        key_size    = HMACKEYLEN, ///< Recommended key size; any size is accepted.
+        digest_size = HMACLEN,    ///< Untruncated HMAC-SHA-256.
+        tag_size    = 16
+    };
+
+    /// Truncated MAC sent along with a packet.
+    using tag = boost::array<unsigned char, tag_size>;
+
+    hmac(unsigned char const* key, size_t size);
+    ~hmac();
+
+    inline explicit hmac(byte_array const& key)
+        : hmac((unsigned char const*)key.const_data(), key.size())
+    {}
+
+    /**
+     * Key from any container accepted by boost::asio::buffer().
+     */
+    template <typename K>
+    explicit hmac(K const& key)
+        : hmac(internal::raw<unsigned char const*>(boost::asio::buffer(key)))
+    {}
+
+    /**
+     * Start a MAC over data given in pieces: update the returned context,
+     * then pass it to finalize().
+     */
+    inline sha256::context begin() const { return inner_; }
+
+    /**
+     * Write the full digest_size HMAC of the data in @a ctx to @a out.
+     * @a ctx is reset to begin() for the next message.
+     */
+    void finalize(sha256::context& ctx, unsigned char* out) const;
+
+    /**
+     * Write the tag_size byte MAC of @a size bytes at @a data to @a out.
+     */
+    void sign(unsigned char const* data, size_t size, unsigned char* out) const;
+
+    inline tag sign(unsigned char const* data, size_t size) const
+    {
+        tag out;
+        sign(data, size, out.data());
+        return out;
+    }
+
+    inline tag sign(byte_array const& data) const {
+        return sign((unsigned char const*)data.const_data(), data.size());
+    }
+
+    /**
+     * Check a tag_size byte MAC in time independent of where it differs.
+     */
+    bool verify(unsigned char const* data, size_t size, unsigned char const* mac) const;
+
+    inline bool verify(byte_array const& data, tag const& mac) const {
+        return verify((unsigned char const*)data.const_data(), data.size(), mac.data());
+    }
+
+    /**
+     * MAC a batch of messages under this key: message i is @a sizes[i] bytes
+     * at @a data[i], its tag goes to @a tags + i * tag_size.
+     * Runs the messages side by side in the sha256_batch lanes when those are available.
+     */
+    void sign(unsigned char const* const* data, size_t const* sizes, size_t count,
+              unsigned char* tags) const;
+
+    /**
+     * Verify a batch of messages against the tags at @a tags + i * tag_size,
+     * setting @a ok[i] for each of them.
+     * @return Number of messages that verified.
+     */
+    size_t verify(unsigned char const* const* data, size_t const* sizes, size_t count,
+                  unsigned char const* tags, bool* ok) const;
+
+private:
+    explicit hmac(internal::raw<unsigned char const*> const& key)
+        : hmac(key.ptr, key.len)
+    {}
+};
+
+} // crypto namespace
@@ -0,0 +1,108 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "krypto/sign_key.h"
+
+namespace crypto {
+
+/**
+ * Key pairs generated ahead of time by background threads.
+ *
+ * Each kind of key (algorithm and size) gets a name, a factory and the number
+ * of keys to keep ready:
+ *
+ *     pool.add("rsa2048", 4, key_pool::make<rsa160_key>(2048));
+ *     auto key = pool.take("rsa2048");
+ *
+ * take() hands out a ready key at once; when the kind has run dry it generates
+ * one on the caller's thread instead and counts that as starvation, which tells
+ * whether the depth is large enough for the load.
+ */
+class key_pool : boost::noncopyable
+{
+public:
+    using key_ptr = std::unique_ptr<sign_key>;
+    using factory = std::function<key_ptr()>;
+
+    struct stats
+    {
+        uint64_t taken;     ///< Keys handed out by take() and try_take().
+        uint64_t starved;   ///< Requests that found no ready key.
+        size_t ready;       ///< Keys waiting now.
+    };
+
+    /**
+     * Start @a threads generator threads.
+     */
+    explicit key_pool(size_t threads = 1);
+    ~key_pool();
+
+    /**
+     * Keep @a depth keys made by @a make ready under @a kind.
+     * Adding a kind again changes its depth and factory.
+     */
+    void add(std::string const& kind, size_t depth, factory make);
+
+    /**
+     * Get a key of @a kind, generating it here if none is ready.
+     * Throws std::runtime_error for a kind that was never added.
+     */
+    key_ptr take(std::string const& kind);
+
+    /**
+     * Get a ready key of @a kind, or an empty pointer.
+     */
+    key_ptr try_take(std::string const& kind);
+
+    stats statistics(std::string const& kind) const;
+
+    /**
+     * Factory for keys built as Key(args...).
+     */
+    template <typename Key, typename... Args>
+    static factory make(Args... args)
+    {
+        return [args...] { return key_ptr(new Key(args...)); };
+    }
+
+private:
+    struct kind_state
+    {
+        factory make;
+        size_t depth{0};
+        size_t generating{0};
+        std::deque<key_ptr> ready;
+        uint64_t taken{0};
+        uint64_t starved{0};
+    };
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::unordered_map<std::string, kind_state> kinds_;
+    std::vector<std::thread> workers_;
+    bool stopping_{false};
+
+    kind_state& state(std::string const& kind);
+    kind_state* next_to_fill();
+    void worker();
+};
+
+} // crypto namespace
@@ -0,0 +1,117 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "krypto/sign_key.h"
+#include "krypto/thread_pool.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * Known peer keys, indexed by sign_key::id().
+ *
+ * The index is an open-addressing table with linear probing. Ids are hash
+ * outputs already, so their leading 64 bits pick the home slot directly; that
+ * keeps keys in id order around the table, and a hashname prefix lookup only
+ * scans the slots its prefix maps to.
+ *
+ * Because the home slot is public, a peer willing to generate about one key per
+ * slot for every key it submits can pile keys onto a single home region and slow
+ * lookups there. A secret offset would not help, it moves such a cluster but keeps
+ * it together. Instead no key is stored more than max_probe slots past its home,
+ * which bounds every probe sequence; keys beyond that are refused.
+ *
+ * When the sender of an open packet is unknown, find_signer() tries the
+ * signature against candidate keys in parallel, and stops once no earlier
+ * candidate is left to try.
+ *
+ * All members may be called from many threads.
+ */
+class key_registry : boost::noncopyable
+{
+public:
+    using key_ptr = std::shared_ptr<sign_key const>;
+
+    enum {
+        /// Farthest a key is stored from its home slot. Random ids at the table's
+        /// load factor stay far below it, even in tables of millions of keys.
+        max_probe = 256
+    };
+
+    /**
+     * Create a registry with room for @a expected keys before it has to grow.
+     */
+    explicit key_registry(size_t expected = 0);
+
+    /**
+     * Add @a key. If a key with the same id is already known, keep that one.
+     * @return true if the key was added; false for duplicates, invalid keys and
+     *         keys that would sit more than max_probe slots from their home.
+     */
+    bool insert(key_ptr key);
+
+    /**
+     * Forget the key with this id.
+     * @return true if there was one.
+     */
+    bool erase(byte_array const& id);
+
+    /// The key with this id, or an empty pointer.
+    key_ptr find(byte_array const& id) const;
+
+    /// All keys whose id starts with @a prefix.
+    std::vector<key_ptr> find_prefix(byte_array const& prefix) const;
+
+    size_t size() const;
+
+    /**
+     * Find which known key made @a signature over @a digest.
+     * @return The first key in table order that verifies it, or an empty pointer.
+     */
+    key_ptr find_signer(byte_array const& digest, byte_array const& signature,
+                        thread_pool& pool = thread_pool::shared()) const;
+
+    /**
+     * The same over a list of @a candidates, e.g. the result of find_prefix().
+     * Candidates near the front are tried first, and the earliest one that
+     * verifies is returned even if a later one verifies too.
+     */
+    static key_ptr find_signer(std::vector<key_ptr> const& candidates,
+                               byte_array const& digest, byte_array const& signature,
+                               thread_pool& pool = thread_pool::shared());
+
+private:
+    struct slot
+    {
+        uint64_t hash;  ///< Leading 64 bits of the id, big-endian.
+        key_ptr key;    ///< Empty for a free slot.
+    };
+
+    mutable std::mutex mutex_;
+    std::vector<slot> slots_;
+    size_t size_{0};
+    int shift_;         ///< 64 - log2(slots_.size()).
+    size_t longest_{0}; ///< No key sits farther than this from its home slot.
+
+    inline size_t home(uint64_t hash) const { return size_t(hash >> shift_); }
+    inline size_t mask() const { return slots_.size() - 1; }
+
+    size_t locate(uint64_t hash, byte_array const& id) const;
+    size_t distance_to_free(uint64_t hash) const;
+    void place(slot&& s);
+    void grow();
+};
+
+} // crypto namespace
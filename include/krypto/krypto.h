@@ -37,10 +37,10 @@ template<typename T>
 struct raw
 {
     T ptr;
-    int len;
+    size_t len;
     template<typename B>
     raw(const B &b) : ptr(boost::asio::buffer_cast<T>(b)),
-        len(static_cast<int>(boost::asio::buffer_size(b)))
+        len(boost::asio::buffer_size(b))
     {}
 };
 
@@ -0,0 +1,100 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <atomic>
+#include <boost/noncopyable.hpp>
+#include "krypto/krypto.h"
+#include "krypto/aes_256_ctr.h"
+#include "krypto/packet.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * Keys and nonces of one telehash line (see doc/telehash.md, "line").
+ *
+ * Owns both directional AES-256-CTR ciphers, keyed once at setup:
+ *
+ *     encrypt key = SHA-256(ecdhe secret | my line id | their line id)
+ *     decrypt key = SHA-256(ecdhe secret | their line id | my line id)
+ *
+ * Outgoing IVs are generated from a per-session random prefix and a packet
+ * counter, laid out as prefix(4) | packet number(8) | block counter(4), so
+ * the keystreams of different packets never overlap for packets below 64 GiB.
+ * Once constructed, encrypt() and decrypt() only work on caller buffers and
+ * never allocate. encrypt() may be called from several threads at once.
+ */
+class line_session : boost::noncopyable
+{
+    aes_256_ctr encrypt_cipher_;
+    aes_256_ctr decrypt_cipher_;
+    unsigned char iv_prefix_[4];
+    std::atomic<uint64_t> sent_{0};
+
+public:
+    enum {
+        key_size     = aes_256_ctr::key_size,
+        iv_size      = aes_256_ctr::iv_size,
+        line_id_size = 16
+    };
+
+    /**
+     * Derive the line keys from the ECDH shared secret and the two line ids
+     * exchanged in the open packets.
+     */
+    line_session(byte_array const& ecdhe_secret,
+                 byte_array const& my_line_id, byte_array const& their_line_id);
+
+    /**
+     * Set up with already derived directional keys.
+     */
+    line_session(byte_array const& encrypt_key, byte_array const& decrypt_key);
+
+    /**
+     * Number of packets encrypted so far, which is also the next packet number.
+     */
+    inline uint64_t packets_sent() const { return sent_.load(std::memory_order_relaxed); }
+
+    /**
+     * Encrypt an outgoing packet with the next nonce.
+     * @param  in    Plaintext, @a size bytes.
+     * @param  out   Ciphertext buffer, @a size bytes; may equal @a in.
+     * @param  iv    Receives the iv_size byte IV to send along with the packet.
+     */
+    void encrypt(unsigned char const* in, unsigned char* out, size_t size, unsigned char* iv);
+
+    /**
+     * Decrypt an incoming packet with the IV it carried.
+     */
+    void decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                 unsigned char const* iv) const;
+
+    /**
+     * Encrypt a batch of outgoing packets. Their IVs are written to @a ivs
+     * (count * iv_size bytes), and each packet's iv is pointed at its slot.
+     * @return Number of packets processed.
+     */
+    size_t encrypt(packet* packets, unsigned char* ivs, size_t count);
+
+    /**
+     * Decrypt a batch of incoming packets, each carrying its own IV.
+     * @return Number of packets processed.
+     */
+    inline size_t decrypt(packet* packets, size_t count) const {
+        return decrypt_cipher_.decrypt(packets, count);
+    }
+
+private:
+    friend struct line_session_access; ///< Test hook for the packet counter.
+
+    void next_iv(unsigned char* iv);
+};
+
+} // crypto namespace
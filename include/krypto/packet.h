@@ -0,0 +1,44 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <cstddef>
+
+namespace crypto {
+
+/**
+ * One entry of a batched encrypt/decrypt call: an IV, a source and a destination buffer,
+ * all owned by the caller. @a out may be the same pointer as @a in for in-place operation,
+ * otherwise the buffers must not overlap.
+ */
+struct packet
+{
+    unsigned char const* iv;
+    unsigned char const* in;
+    unsigned char* out;
+    size_t size;
+    bool ok; ///< Set by the batch call: true if the packet was processed.
+};
+
+namespace internal {
+
+/// Check that a batch entry describes usable buffers.
+inline bool valid(packet const& p)
+{
+    if (p.iv == nullptr)
+        return false;
+    if (p.size == 0)
+        return true;
+    if (p.in == nullptr or p.out == nullptr)
+        return false;
+    return p.in == p.out or p.in + p.size <= p.out or p.out + p.size <= p.in;
+}
+
+} // internal namespace
+} // crypto namespace
@@ -0,0 +1,98 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <algorithm>
+#include "krypto/krypto.h"
+#include "krypto/thread_pool.h"
+
+namespace crypto {
+
+/**
+ * Multi-threaded counter-mode encryption of large buffers.
+ *
+ * Works with any cipher offering the encrypt(in, out, size, iv, ic) overload
+ * (aes_128_ctr, aes_256_ctr, xsalsa20). The buffer is cut into block-aligned
+ * segments, each encrypted from its own keystream block index on @a pool, so the
+ * output is byte-identical to a single serial encrypt() call.
+ * Buffers smaller than two segments are encrypted on the calling thread.
+ */
+namespace parallel_ctr {
+
+/// Smallest segment handed to a worker; below this, thread wakeup dominates.
+const size_t min_segment_size = 256 * 1024;
+
+/**
+ * Segment size used for @a size bytes on @a pool: about four segments per thread
+ * for load balancing, rounded up to a multiple of @a block_size.
+ */
+inline size_t segment_size(size_t size, size_t block_size, thread_pool const& pool)
+{
+    size_t segment = std::max(min_segment_size, size / (pool.concurrency() * 4));
+    return (segment + block_size - 1) / block_size * block_size;
+}
+
+/**
+ * Encrypt @a size bytes from @a in to @a out with @a cipher and @a iv in parallel.
+ * @a in and @a out must either be the same pointer (in-place) or not overlap.
+ * @param segment  Bytes per piece of work, multiple of Cipher::block_size; 0 picks one.
+ */
+template <typename Cipher>
+void encrypt(Cipher const& cipher, unsigned char const* in, unsigned char* out, size_t size,
+             unsigned char const* iv, thread_pool& pool = thread_pool::shared(), size_t segment = 0)
+{
+    if (segment == 0) {
+        segment = segment_size(size, Cipher::block_size, pool);
+    }
+    assert(segment % Cipher::block_size == 0);
+
+    size_t count = (size + segment - 1) / segment;
+    if (count < 2) {
+        cipher.encrypt(in, out, size, iv);
+        return;
+    }
+
+    pool.parallel_for(count, [&](size_t i) {
+        size_t offset = i * segment;
+        size_t n = std::min(segment, size - offset);
+        cipher.encrypt(in + offset, out + offset, n, iv, offset / Cipher::block_size);
+    });
+}
+
+/**
+ * Encrypt between containers accepted by boost::asio::buffer(); @a out must be at least as large as @a in.
+ */
+template <typename Cipher, typename I, typename O, typename V>
+void encrypt(Cipher const& cipher, I const& in, O& out, V const& iv,
+             thread_pool& pool = thread_pool::shared())
+{
+    internal::raw<unsigned char const*> i(boost::asio::buffer(in));
+    internal::raw<unsigned char*> o(boost::asio::buffer(out));
+    internal::raw<unsigned char const*> v(boost::asio::buffer(iv));
+    assert(o.len >= i.len);
+    assert(v.len == Cipher::iv_size);
+    encrypt(cipher, i.ptr, o.ptr, i.len, v.ptr, pool);
+}
+
+template <typename Cipher>
+inline void decrypt(Cipher const& cipher, unsigned char const* in, unsigned char* out, size_t size,
+                    unsigned char const* iv, thread_pool& pool = thread_pool::shared(), size_t segment = 0)
+{
+    encrypt(cipher, in, out, size, iv, pool, segment);
+}
+
+template <typename Cipher, typename I, typename O, typename V>
+inline void decrypt(Cipher const& cipher, I const& in, O& out, V const& iv,
+                    thread_pool& pool = thread_pool::shared())
+{
+    encrypt(cipher, in, out, iv, pool);
+}
+
+} // parallel_ctr namespace
+} // crypto namespace
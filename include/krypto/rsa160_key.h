@@ -8,14 +8,34 @@
 //
 #pragma once
 
+#include <mutex>
+#include <vector>
 #include <openssl/rsa.h>
 #include "krypto/sign_key.h"
 
 namespace crypto {
 
+/**
+ * RSA key with 160-bit id (SHA-256 of the public key, truncated).
+ *
+ * Montgomery contexts for n, p and q are built once when the key is loaded or
+ * generated and only read afterwards, so signing and verifying never take
+ * OpenSSL's RSA lock. sign() does the CRT exponentiation with those contexts
+ * and blinds with state taken from a per-key pool, one entry per concurrently
+ * signing thread, instead of OpenSSL's shared blinding.
+ *
+ * A key whose fields fail to decode or check out is left invalid.
+ */
 class rsa160_key : public sign_key
 {
+    struct blinding;
+
     RSA* rsa_;
+    BN_MONT_CTX* mont_n_{nullptr};
+    BN_MONT_CTX* mont_p_{nullptr};
+    BN_MONT_CTX* mont_q_{nullptr};
+    mutable std::mutex blindings_mutex_;
+    mutable std::vector<blinding*> blindings_; ///< Idle blinding state, reused by sign().
 
     rsa160_key(RSA* rsa);
 
@@ -24,15 +44,28 @@ public:
     rsa160_key(int bits = 0, unsigned e = 65537);
     ~rsa160_key();
 
-    byte_array id() const override;
-
-    byte_array public_key() const override;
     byte_array private_key() const override;
 
+    /**
+     * RSASSA-PKCS1-v1_5 signature over a SHA-256 @a digest.
+     * @return The signature, or an empty byte_array if signing failed.
+     * @throws std::runtime_error for a key without its private part.
+     */
     byte_array sign(byte_array const& digest) const override;
     bool verify(byte_array const& digest, byte_array const& signature) const override;
 
+protected:
+    byte_array encode_public_key() const override;
+
+    // Only return 160 bits of key identity information,
+    // because this method's security may be limited by the SHA-1 hash
+    // used in the RSA-OAEP padding process.
+    size_t id_size() const override { return 160/8; }
+
 private:
+    bool precompute();
+    blinding* acquire_blinding() const;
+    void release_blinding(blinding* b) const;
     void dump() const;
 };
 
@@ -10,25 +10,89 @@
 //
 #pragma once
 
+#include <vector>
 #include <crypto_hash_sha256.h>
 #include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/hash_context.h"
 #include "arsenal/byte_array.h"
 
 namespace crypto {
 namespace sha256 {
 
-inline std::string
+enum {
+    digest_size = crypto_hash_sha256_BYTES,
+    block_size  = 64
+};
+
+/// Fixed-size SHA-256 digest, lives on the stack.
+using digest = boost::array<unsigned char, digest_size>;
+
+/**
+ * Incremental SHA-256 on the kernel dispatch selected (SHA-NI, OpenSSL or portable).
+ *
+ *     crypto::sha256::context ctx;
+ *     ctx.update(header);
+ *     ctx.update(body.data(), body.size());
+ *     crypto::sha256::digest d = ctx.finalize();
+ */
+using context = basic_context<digest_size, dispatch::sha256>;
+
+inline digest
+hash(unsigned char const* data, size_t size)
+{
+    digest out;
+    dispatch::sha256().hash(data, size, out.data());
+    return out;
+}
+
+inline digest
 hash(char const* data, size_t size)
 {
-    return "";
-    // return crypto_hash_sha256(std::string(data, size));
+    return hash((unsigned char const*)data, size);
 }
 
-inline std::string
+inline digest
 hash(byte_array const& data)
 {
-    return "";
-    // return crypto_hash_sha256(data.as_string());
+    return hash(data.const_data(), data.size());
+}
+
+/**
+ * Hash @a count independent messages at once, in AVX2/AVX-512 lanes when available.
+ * Meant for many short messages, e.g. deriving hashnames from a burst of public keys.
+ * Message i is @a sizes[i] bytes at @a data[i]; its digest goes to @a out[i].
+ */
+inline void
+hash_batch(unsigned char const* const* data, size_t const* sizes, size_t count, digest* out)
+{
+    static_assert(sizeof(digest) == digest_size, "digests must be contiguous");
+    if (count > 0) {
+        dispatch::sha256_batch()(data, sizes, count, out[0].data());
+    }
+}
+
+inline std::vector<digest>
+hash_batch(std::vector<byte_array> const& messages)
+{
+    std::vector<unsigned char const*> data(messages.size());
+    std::vector<size_t> sizes(messages.size());
+    for (size_t i = 0; i < messages.size(); ++i) {
+        data[i] = (unsigned char const*)messages[i].const_data();
+        sizes[i] = messages[i].size();
+    }
+    std::vector<digest> out(messages.size());
+    hash_batch(data.data(), sizes.data(), messages.size(), out.data());
+    return out;
+}
+
+/**
+ * Digest as a byte_array, e.g. to serialise it.
+ */
+inline byte_array
+to_byte_array(digest const& d)
+{
+    return byte_array((char const*)d.data(), d.size());
 }
 
 } // sha256 namespace
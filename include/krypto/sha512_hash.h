@@ -12,19 +12,58 @@
 
 #include <crypto_hash_sha512.h>
 #include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/hash_context.h"
 #include "arsenal/byte_array.h"
 
 namespace crypto {
 namespace sha512 {
 
-inline std::string hash(char const* data, size_t size)
+enum {
+    digest_size = crypto_hash_sha512_BYTES,
+    block_size  = 128
+};
+
+/// Fixed-size SHA-512 digest, lives on the stack.
+using digest = boost::array<unsigned char, digest_size>;
+
+/**
+ * Incremental SHA-512 on the kernel dispatch selected (OpenSSL or portable).
+ *
+ *     crypto::sha512::context ctx;
+ *     ctx.update(header);
+ *     ctx.update(body.data(), body.size());
+ *     crypto::sha512::digest d = ctx.finalize();
+ */
+using context = basic_context<digest_size, dispatch::sha512>;
+
+inline digest
+hash(unsigned char const* data, size_t size)
+{
+    digest out;
+    dispatch::sha512().hash(data, size, out.data());
+    return out;
+}
+
+inline digest
+hash(char const* data, size_t size)
+{
+    return hash((unsigned char const*)data, size);
+}
+
+inline digest
+hash(byte_array const& data)
 {
-    return crypto_hash_sha512(std::string(data, size));
+    return hash(data.const_data(), data.size());
 }
 
-inline std::string hash(byte_array const& data)
+/**
+ * Digest as a byte_array, e.g. to serialise it.
+ */
+inline byte_array
+to_byte_array(digest const& d)
 {
-    return crypto_hash_sha512(data.as_string());
+    return byte_array((char const*)d.data(), d.size());
 }
 
 } // sha512 namespace
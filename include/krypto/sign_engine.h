@@ -0,0 +1,116 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/asio/io_service.hpp>
+#include <boost/noncopyable.hpp>
+#include "krypto/sign_key.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * Runs sign_key::sign() and verify() off the caller's thread.
+ *
+ * Jobs are spread over per-worker queues; a worker that runs dry steals from
+ * the back of the others, so one slow RSA sign does not hold up the jobs queued
+ * behind it. Jobs submitted from inside a job go to the queue of the worker
+ * running it. Results come back as futures, or as handlers posted to an asio
+ * io_service so that they run on the network thread:
+ *
+ *     engine.async_verify(key, digest, signature, io,
+ *         [this](bool valid) { if (valid) open_line(); });
+ *
+ * Keys are held by shared_ptr until their job has run. Queued jobs are still
+ * run when the engine is destroyed.
+ */
+class sign_engine : boost::noncopyable
+{
+public:
+    using clock = std::chrono::steady_clock;
+    /// Receives the signature, or an empty byte_array if signing failed.
+    using sign_handler = std::function<void(byte_array const& signature)>;
+    /// Receives the verification result; a verify that throws counts as failed.
+    using verify_handler = std::function<void(bool valid)>;
+
+    /**
+     * Start @a threads workers; 0 means one per hardware thread.
+     */
+    explicit sign_engine(size_t threads = 0);
+    ~sign_engine();
+
+    std::future<byte_array> sign(std::shared_ptr<sign_key const> key, byte_array digest);
+    std::future<bool> verify(std::shared_ptr<sign_key const> key, byte_array digest,
+                             byte_array signature);
+
+    void async_sign(std::shared_ptr<sign_key const> key, byte_array digest,
+                    boost::asio::io_service& io, sign_handler handler);
+    void async_verify(std::shared_ptr<sign_key const> key, byte_array digest,
+                      byte_array signature, boost::asio::io_service& io, verify_handler handler);
+
+    inline size_t threads() const { return workers_.size(); }
+
+    /// Jobs submitted but not yet started.
+    inline size_t queue_depth() const { return pending_.load(std::memory_order_relaxed); }
+
+    /// Jobs finished so far.
+    inline uint64_t completed() const { return completed_.load(std::memory_order_relaxed); }
+
+    /// Jobs a worker took from another worker's queue.
+    inline uint64_t stolen() const { return stolen_.load(std::memory_order_relaxed); }
+
+    /// Mean time from submission to completion over all finished jobs.
+    clock::duration average_latency() const;
+
+    /// Longest time from submission to completion seen so far.
+    inline clock::duration max_latency() const {
+        return clock::duration(max_latency_.load(std::memory_order_relaxed));
+    }
+
+private:
+    struct job
+    {
+        std::function<void()> run;
+        clock::time_point queued;
+    };
+
+    struct queue
+    {
+        std::mutex mutex;
+        std::deque<job> jobs;
+    };
+
+    std::vector<std::unique_ptr<queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex idle_mutex_;
+    std::condition_variable wake_;
+    bool stopping_{false};
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> next_queue_{0};
+    std::atomic<uint64_t> completed_{0};
+    std::atomic<uint64_t> stolen_{0};
+    std::atomic<uint64_t> total_latency_{0};  ///< In clock ticks.
+    std::atomic<clock::rep> max_latency_{0};
+
+    void submit(std::function<void()> fn);
+    bool take(size_t self, job& out);
+    void worker(size_t self);
+};
+
+} // crypto namespace
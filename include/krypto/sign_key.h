@@ -9,6 +9,8 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "arsenal/byte_array.h"
 
 namespace crypto {
@@ -48,15 +50,26 @@ public:
 
     /**
      * Get the short hash ID of this public or private key,
-     * which is usable only for uniquely identifying the key.
+     * which is usable only for uniquely identifying the key:
+     * the first id_size() bytes of SHA-256 of public_key().
+     * Computed on first use and kept; safe to call from many threads.
      */
-    virtual byte_array id() const = 0;
+    byte_array const& id() const;
+
+    /**
+     * Get id() of many keys at once; their public keys are hashed
+     * side by side in SIMD lanes (see sha256::hash_batch()).
+     * Keys whose id() was not computed yet keep the result.
+     * @return Key IDs, in the order of @a keys.
+     */
+    static std::vector<byte_array> ids(std::vector<sign_key const*> const& keys);
 
     /**
      * Get binary-encoded public key.
+     * Serialized on first use and kept; safe to call from many threads.
      * @return Serialized public key data.
      */
-    virtual byte_array public_key() const = 0;
+    byte_array const& public_key() const;
 
     /**
      * Get binary-encoded public and private keys.
@@ -84,8 +97,23 @@ protected:
 
     inline void set_type(key_type t) { type_ = t; }
 
+    /**
+     * Serialize the public part of the key. Called at most once, by the first
+     * public_key() or id(), so the key must not change after construction.
+     */
+    virtual byte_array encode_public_key() const = 0;
+
+    /**
+     * Number of leading bytes of the public key SHA-256 that make up id().
+     */
+    virtual size_t id_size() const { return 32; }
+
 private:
     key_type type_;
+    mutable std::once_flag public_key_once_;
+    mutable std::once_flag id_once_;
+    mutable byte_array public_key_;
+    mutable byte_array id_;
 };
 
 } // crypto namespace
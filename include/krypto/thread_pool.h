@@ -0,0 +1,72 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+namespace crypto {
+
+/**
+ * Fixed set of worker threads for data-parallel crypto work.
+ *
+ * parallel_for() splits a job into @a count independent pieces and blocks until
+ * all of them are done; the calling thread takes pieces too, so a pool of N workers
+ * gives N+1 way parallelism. Jobs from different threads are run one after another.
+ */
+class thread_pool : boost::noncopyable
+{
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::mutex job_mutex_;                  ///< Serialises parallel_for() callers.
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::function<void(size_t)> const* job_{nullptr};
+    size_t count_{0};
+    size_t next_{0};
+    size_t finished_{0};
+    uint64_t generation_{0};
+    bool stopping_{false};
+
+public:
+    /**
+     * Start @a threads workers; 0 means one less than the number of hardware threads.
+     */
+    explicit thread_pool(size_t threads = 0);
+    ~thread_pool();
+
+    /**
+     * Number of threads that run pieces of a job, including the caller.
+     */
+    inline size_t concurrency() const { return workers_.size() + 1; }
+
+    /**
+     * Run @a fn(0) .. @a fn(count - 1) across the pool and wait for all of them.
+     * @a fn must not throw. A call made from inside a piece of this pool's job
+     * runs serially on the calling thread instead of deadlocking.
+     */
+    void parallel_for(size_t count, std::function<void(size_t)> const& fn);
+
+    /**
+     * Process-wide pool sized to the hardware, created on first use.
+     */
+    static thread_pool& shared();
+
+private:
+    void worker();
+    bool run_pieces(std::unique_lock<std::mutex>& lock);
+};
+
+} // crypto namespace
@@ -0,0 +1,94 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <vector>
+#include "krypto/sha256_hash.h"
+#include "krypto/thread_pool.h"
+#include "arsenal/byte_array.h"
+
+namespace crypto {
+
+/**
+ * SHA-256 Merkle tree over fixed-size chunks, see doc/tree_hash.md for the format.
+ *
+ * Chunks are hashed in parallel on a thread_pool, so large blobs hash at the
+ * speed of all cores rather than one. The chunk (leaf) digests are available to
+ * the caller: sent along with the root, they let a receiver check every chunk
+ * of a partial download on arrival. proof() gives the shorter audit path for
+ * a single chunk instead.
+ *
+ *     std::vector<crypto::tree_hash::digest> chunks = crypto::tree_hash::leaves(data, size);
+ *     crypto::tree_hash::digest root = crypto::tree_hash::root(chunks);
+ *     ...
+ *     if (crypto::tree_hash::leaf(chunk, chunk_size) != chunks[i]) ...
+ */
+namespace tree_hash {
+
+using digest = sha256::digest;
+
+/// Chunk size unless told otherwise. It is a parameter of the tree: both ends must agree on it.
+const size_t default_chunk_size = 1 << 20;
+
+/**
+ * Number of leaves for @a size bytes of data; empty data is one empty chunk.
+ */
+inline size_t chunk_count(size_t size, size_t chunk_size = default_chunk_size)
+{
+    return size == 0 ? 1 : (size + chunk_size - 1) / chunk_size;
+}
+
+/// Leaf digest: SHA-256(0x00 | chunk).
+digest leaf(unsigned char const* chunk, size_t size);
+
+/// Interior node digest: SHA-256(0x01 | left | right).
+digest node(digest const& left, digest const& right);
+
+/**
+ * Digests of the consecutive @a chunk_size byte chunks of @a data (the last one
+ * may be shorter), hashed on @a pool.
+ */
+std::vector<digest> leaves(unsigned char const* data, size_t size,
+                           size_t chunk_size = default_chunk_size,
+                           thread_pool& pool = thread_pool::shared());
+
+/**
+ * Combine leaf digests into the root.
+ */
+digest root(std::vector<digest> const& leaves);
+
+/**
+ * Tree hash of @a size bytes at @a data.
+ */
+inline digest hash(unsigned char const* data, size_t size,
+                   size_t chunk_size = default_chunk_size,
+                   thread_pool& pool = thread_pool::shared())
+{
+    return root(leaves(data, size, chunk_size, pool));
+}
+
+inline digest hash(byte_array const& data, size_t chunk_size = default_chunk_size)
+{
+    return hash((unsigned char const*)data.const_data(), data.size(), chunk_size);
+}
+
+/**
+ * Audit path of leaf @a index: the sibling digests on the way to the root.
+ */
+std::vector<digest> proof(std::vector<digest> const& leaves, size_t index);
+
+/**
+ * Check that a chunk with digest @a leaf_digest is leaf @a index of a tree
+ * with @a count leaves and root @a root_digest.
+ */
+bool verify(digest const& leaf_digest, size_t index, size_t count,
+            std::vector<digest> const& proof, digest const& root_digest);
+
+} // tree_hash namespace
+} // crypto namespace
@@ -0,0 +1,90 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <boost/noncopyable.hpp>
+#include "krypto/sha256_hash.h"
+#include "krypto/sign_key.h"
+
+namespace crypto {
+
+/**
+ * Bounded, thread-safe cache of successful signature verifications.
+ *
+ * Retransmitted open packets carry the very same signature, so their
+ * public-key verification can be answered from memory:
+ *
+ *     crypto::verify_cache cache(1024, std::chrono::minutes(1));
+ *     if (cache.verify(peer_key, digest, signature)) ...
+ *
+ * Entries are keyed by SHA-256 of (key id, digest, signature) and only
+ * successful verifications are stored, so a forged signature always costs
+ * a real verify. The least recently used entry is dropped when full, and
+ * entries older than the TTL are not trusted any more.
+ */
+class verify_cache : boost::noncopyable
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    explicit verify_cache(size_t capacity = 4096,
+                          clock::duration ttl = std::chrono::minutes(10));
+
+    /**
+     * key.verify(digest, signature), skipping the verify if it succeeded before.
+     */
+    bool verify(sign_key const& key, byte_array const& digest, byte_array const& signature);
+
+    /// Calls answered from the cache.
+    inline uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    /// Calls that had to run a verification.
+    inline uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+    size_t size() const;
+    void clear();
+
+private:
+    using entry_key = sha256::digest;
+
+    struct entry
+    {
+        entry_key key;
+        clock::time_point expires;
+    };
+
+    /// The key is already a uniform hash; use its leading bytes.
+    struct key_hash
+    {
+        size_t operator()(entry_key const& k) const
+        {
+            size_t h;
+            std::memcpy(&h, k.data(), sizeof(h));
+            return h;
+        }
+    };
+
+    size_t capacity_;
+    clock::duration ttl_;
+    mutable std::mutex mutex_;
+    std::list<entry> lru_; ///< Most recently used first.
+    std::unordered_map<entry_key, std::list<entry>::iterator, key_hash> index_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    bool lookup(entry_key const& k);
+    void insert(entry_key const& k);
+};
+
+} // crypto namespace
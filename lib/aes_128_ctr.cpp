@@ -6,29 +6,105 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
+#include <algorithm>
 #include <boost/asio/buffer.hpp>
 #include <crypto_stream_aes128ctr.h>
 #include "krypto/aes_128_ctr.h"
 #include "krypto/krypto.h"
+#include "aes_ni.h"
 
 namespace crypto {
 
+namespace {
+
+/**
+ * Advance the counter block by @a blocks, libsodium style: only the last
+ * 32 bits are the big-endian counter and they wrap around on overflow.
+ */
+void advance_counter(unsigned char* ctr, uint64_t blocks)
+{
+    uint32_t c = (uint32_t(ctr[12]) << 24) | (uint32_t(ctr[13]) << 16)
+               | (uint32_t(ctr[14]) << 8) | uint32_t(ctr[15]);
+    c += uint32_t(blocks);
+    ctr[12] = c >> 24;
+    ctr[13] = c >> 16;
+    ctr[14] = c >> 8;
+    ctr[15] = c;
+}
+
+} // anonymous namespace
+
 aes_128_ctr::aes_128_ctr(byte_array const& key)
+    : impl_(dispatch::selected(dispatch::primitive::aes_128_ctr))
 {
-    key_ = key.as_string();
-    assert(key_.length() == crypto_stream_aes128ctr_KEYBYTES);
+    assert(key.size() == crypto_stream_aes128ctr_KEYBYTES);
+    unsigned char const* k = (unsigned char const*)key.const_data();
+    if (impl_ == dispatch::impl::portable) {
+        crypto_stream_aes128ctr_beforenm(key_schedule_, k);
+    } else {
+        aesni::expand_key_128(k, round_keys_);
+    }
 }
 
 aes_128_ctr::~aes_128_ctr()
 {
-    auto wrap = boost::asio::buffer((void*)&key_, crypto_stream_aes128ctr_KEYBYTES);
-    crypto::cleanse(wrap); // Do not leave keys lying around.
+    crypto::cleanse(key_schedule_); // Do not leave keys lying around.
+    crypto::cleanse(round_keys_);
 }
 
 byte_array aes_128_ctr::encrypt(byte_array const& in, std::string iv)
 {
     assert(iv.length() == crypto_stream_aes128ctr_NONCEBYTES);
-    return crypto_stream_aes128ctr_xor(in.as_string(), iv, key_);
+    byte_array out;
+    out.resize(in.size());
+    encrypt((unsigned char const*)in.const_data(), (unsigned char*)out.data(), in.size(),
+        (unsigned char const*)iv.data());
+    return out;
+}
+
+void aes_128_ctr::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
+{
+    assert(in == out or in + size <= out or out + size <= in);
+    if (impl_ == dispatch::impl::vaes) {
+        aesni::ctr32_xor_vaes(round_keys_, 10, in, out, size, iv);
+    } else if (impl_ == dispatch::impl::aesni) {
+        aesni::ctr32_xor(round_keys_, 10, in, out, size, iv);
+    } else {
+        crypto_stream_aes128ctr_xor_afternm(out, in, size, iv, key_schedule_);
+    }
+}
+
+void aes_128_ctr::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv, uint64_t ic) const
+{
+    unsigned char ctr[iv_size];
+    std::copy(iv, iv + iv_size, ctr);
+    advance_counter(ctr, ic);
+    encrypt(in, out, size, ctr);
+}
+
+size_t aes_128_ctr::encrypt(packet* packets, size_t count) const
+{
+    size_t done = 0;
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].ok = internal::valid(packets[i]);
+        if (packets[i].ok) {
+            ++done;
+        }
+    }
+
+    if (impl_ != dispatch::impl::portable) {
+        aesni::ctr32_xor_batch(round_keys_, 10, packets, count);
+        return done;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (packets[i].ok) {
+            encrypt(packets[i].in, packets[i].out, packets[i].size, packets[i].iv);
+        }
+    }
+    return done;
 }
 
 } // crypto namespace
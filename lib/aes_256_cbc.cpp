@@ -6,74 +6,245 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
-// Not used with NaCl?
+// Not used with NaCl, kept for interoperability with legacy peers.
 //
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include <boost/asio/buffer.hpp>
 #include "krypto/aes_256_cbc.h"
 #include "krypto/krypto.h"
+#include "aes_ni.h"
 
 namespace crypto {
 
+namespace {
+
+bool valid_cbc(packet const& p)
+{
+    return internal::valid(p) and p.size % aes_256_cbc::block_size == 0;
+}
+
+EVP_CIPHER const* cbc_for_key(int keysize)
+{
+    switch (keysize)
+    {
+        case 128: return EVP_aes_128_cbc();
+        case 192: return EVP_aes_192_cbc();
+    }
+    return EVP_aes_256_cbc();
+}
+
+EVP_CIPHER_CTX* copy_context(EVP_CIPHER_CTX const* from)
+{
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx or !EVP_CIPHER_CTX_copy(ctx, from))
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        internal::api("AES-CBC context copy", 0);
+    }
+    return ctx;
+}
+
+/**
+ * Run the keyed @a ctx over @a size bytes, a multiple of the block size, chained from @a iv.
+ * Setting only the IV keeps the expanded key and the direction.
+ */
+void cbc_run(EVP_CIPHER_CTX* ctx, unsigned char const* in, unsigned char* out, size_t size,
+             unsigned char const* iv)
+{
+    internal::api("AES-CBC iv", EVP_CipherInit_ex(ctx, nullptr, nullptr, nullptr, iv, -1));
+    while (size > 0)
+    {
+        int chunk = int(std::min<size_t>(size, INT_MAX & ~15));
+        int len = 0;
+        internal::api("AES-CBC", EVP_CipherUpdate(ctx, out, &len, in, chunk));
+        assert(len == chunk); // Padding is off, nothing is held back.
+        in += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+} // anonymous namespace
+
 aes_256_cbc::aes_256_cbc(type which, byte_array const& key)
+    : which_(which)
+    , keyed_(nullptr)
+    , context_(nullptr)
+    , impl_(dispatch::selected(dispatch::primitive::aes_256_cbc))
+{
+    int keysize = key.size() * 8;
+    assert(keysize == 128 or keysize == 192 or keysize == 256);
+    if (keysize != 128 and keysize != 192 and keysize != 256) {
+        throw std::runtime_error("AES-CBC key must be 128, 192 or 256 bits");
+    }
+    rounds_ = 6 + keysize / 32;
+
+    unsigned char const* k = (unsigned char const*)key.const_data();
+
+    // The AES-NI kernels only expand 128 and 256 bit keys.
+    if (impl_ != dispatch::impl::portable and keysize == 192) {
+        impl_ = dispatch::impl::portable;
+    }
+
+    if (impl_ == dispatch::impl::portable)
+    {
+        keyed_ = EVP_CIPHER_CTX_new();
+        if (!keyed_
+            or !EVP_CipherInit_ex(keyed_, cbc_for_key(keysize), nullptr, k, nullptr,
+                                  which == type::encrypt)
+            or !EVP_CIPHER_CTX_set_padding(keyed_, 0))
+        {
+            EVP_CIPHER_CTX_free(keyed_);
+            internal::api("AES-CBC key setup", 0);
+        }
+        try {
+            context_ = copy_context(keyed_);
+        } catch (...) {
+            EVP_CIPHER_CTX_free(keyed_);
+            throw;
+        }
+        return;
+    }
+
+    if (keysize == 128) {
+        aesni::expand_key_128(k, round_keys_);
+    } else {
+        aesni::expand_key_256(k, round_keys_);
+    }
+    if (which == type::decrypt) {
+        alignas(16) unsigned char encryption_keys[sizeof(round_keys_)];
+        std::copy(round_keys_, round_keys_ + sizeof(round_keys_), encryption_keys);
+        aesni::invert_key(encryption_keys, rounds_, round_keys_);
+        crypto::cleanse(encryption_keys);
+    }
+}
+
+aes_256_cbc::~aes_256_cbc()
+{
+    EVP_CIPHER_CTX_free(context_); // Both cleanse the expanded key.
+    EVP_CIPHER_CTX_free(keyed_);
+    crypto::cleanse(round_keys_); // Do not leave keys lying around.
+}
+
+void aes_256_cbc::run_portable(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
 {
-    /*    if (which == type::encrypt) {
-            int keysize = key.size() * 8;
-            assert(keysize == 128 or keysize == 192 or keysize == 256);
-            int rc = AES_set_encrypt_key((const unsigned char*)key.const_data(), keysize, &key_);
-            assert(rc == 0);
-            if (rc != 0) {
-                throw std::runtime_error("Cannot set AES-256-CBC encryption key");
-            }
-        } else {
-            int keysize = key.size() * 8;
-            assert(keysize == 128 or keysize == 192 or keysize == 256);
-            int rc = AES_set_decrypt_key((const unsigned char*)key.const_data(), keysize, &key_);
-            assert(rc == 0);
-            if (rc != 0) {
-                throw std::runtime_error("Cannot set AES-256-CBC decryption key");
-            }
-        }*/
+    // Concurrent callers run on their own copy of the key.
+    std::unique_lock<std::mutex> guard(context_lock_, std::try_to_lock);
+    if (guard.owns_lock()) {
+        cbc_run(context_, in, out, size, iv);
+        return;
+    }
+    std::unique_ptr<EVP_CIPHER_CTX, void (*)(EVP_CIPHER_CTX*)> ctx(copy_context(keyed_),
+                                                                 EVP_CIPHER_CTX_free);
+    cbc_run(ctx.get(), in, out, size, iv);
 }
 
-byte_array
-aes_256_cbc::encrypt(byte_array const& in)
-{ /*
-     int size = in.size();
-     int padsize = (size + AES_BLOCK_SIZE-1) & ~(AES_BLOCK_SIZE-1);
+byte_array aes_256_cbc::encrypt(byte_array const& in)
+{
+    size_t size = in.size();
+    size_t full = size & ~size_t(block_size - 1);
+    size_t padsize = (size + block_size - 1) & ~size_t(block_size - 1);
+
+    byte_array out;
+    out.resize(block_size + padsize);
+    unsigned char* iv = (unsigned char*)out.data();
+    auto iv_buffer = boost::asio::buffer(iv, block_size);
+    crypto::fill_random(iv_buffer);
+    unsigned char* ciphertext = iv + block_size;
 
-     byte_array ivec;
-     ivec.resize(AES_BLOCK_SIZE);
-     crypto::fill_random(ivec.as_vector());
+    encrypt((unsigned char const*)in.const_data(), ciphertext, full, iv);
+    if (full != size)
+    {
+        // Zero-pad the tail through a scratch block, chained from the last ciphertext block.
+        unsigned char block[block_size] = {0};
+        std::copy(in.const_data() + full, in.const_data() + size, block);
+        encrypt(block, ciphertext + full, block_size, ciphertext + full - block_size);
+        crypto::cleanse(block);
+    }
+    return out;
+}
 
-     byte_array out = ivec;
-     out.resize(AES_BLOCK_SIZE + padsize);
+byte_array aes_256_cbc::decrypt(byte_array const& in)
+{
+    if (in.size() <= block_size or (in.size() % block_size) != 0) {
+        return byte_array();
+    }
+    size_t padsize = in.size() - block_size;
 
-     AES_cbc_encrypt((const unsigned char*)in.const_data(), (unsigned char*)out.data() +
-     AES_BLOCK_SIZE,
-         size, &key_, (unsigned char*)ivec.data(), AES_ENCRYPT);
- */
     byte_array out;
+    out.resize(padsize);
+    unsigned char const* iv = (unsigned char const*)in.const_data();
+    decrypt(iv + block_size, (unsigned char*)out.data(), padsize, iv);
     return out;
 }
 
-byte_array
-aes_256_cbc::decrypt(byte_array const& in)
-{ /*
-     int padsize = in.size() - AES_BLOCK_SIZE;
-     if (padsize <= 0 or (padsize % AES_BLOCK_SIZE) != 0)
-         return byte_array();
+void aes_256_cbc::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
+{
+    assert(which_ == type::encrypt);
+    assert(size % block_size == 0);
+    assert(in == out or in + size <= out or out + size <= in);
+    if (impl_ != dispatch::impl::portable) {
+        aesni::cbc_encrypt(round_keys_, rounds_, in, out, size, iv);
+        return;
+    }
 
-     byte_array ivec = in;
-     ivec.resize(AES_BLOCK_SIZE);//@fixme very inefficient
+    run_portable(in, out, size, iv);
+}
 
-     byte_array out;
-     out.resize(padsize);
+void aes_256_cbc::decrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
+{
+    assert(which_ == type::decrypt);
+    assert(size % block_size == 0);
+    assert(in == out or in + size <= out or out + size <= in);
+    if (impl_ != dispatch::impl::portable) {
+        aesni::cbc_decrypt(round_keys_, rounds_, in, out, size, iv);
+        return;
+    }
 
-     AES_cbc_encrypt((const unsigned char*)in.const_data() + AES_BLOCK_SIZE,
-             (unsigned char*)out.data(),
-             padsize, &key_, (unsigned char*)ivec.data(), AES_DECRYPT);
- */
-    byte_array out;
-    return out;
+    run_portable(in, out, size, iv);
+}
+
+size_t aes_256_cbc::encrypt(packet* packets, size_t count) const
+{
+    assert(which_ == type::encrypt);
+    size_t done = 0;
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].ok = valid_cbc(packets[i]);
+        if (packets[i].ok) {
+            ++done;
+        }
+    }
+
+    if (impl_ != dispatch::impl::portable) {
+        aesni::cbc_encrypt_batch(round_keys_, rounds_, packets, count);
+        return done;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (packets[i].ok) {
+            encrypt(packets[i].in, packets[i].out, packets[i].size, packets[i].iv);
+        }
+    }
+    return done;
+}
+
+size_t aes_256_cbc::decrypt(packet* packets, size_t count) const
+{
+    // Decryption is already parallel within each message.
+    size_t done = 0;
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].ok = valid_cbc(packets[i]);
+        if (packets[i].ok) {
+            decrypt(packets[i].in, packets[i].out, packets[i].size, packets[i].iv);
+            ++done;
+        }
+    }
+    return done;
 }
 
 } // crypto namespace
@@ -0,0 +1,180 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <climits>
+#include <memory>
+#include "krypto/aes_256_ctr.h"
+#include "krypto/krypto.h"
+#include "aes_ni.h"
+
+namespace crypto {
+
+namespace {
+
+/**
+ * Advance the counter block by @a blocks as a 128-bit big-endian number.
+ */
+void advance_counter(unsigned char* ctr, uint64_t blocks)
+{
+    for (int i = aes_256_ctr::iv_size - 1; i >= 0 and blocks != 0; --i) {
+        blocks += ctr[i];
+        ctr[i] = blocks & 0xff;
+        blocks >>= 8;
+    }
+}
+
+EVP_CIPHER_CTX* copy_context(EVP_CIPHER_CTX const* from)
+{
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    if (!ctx or !EVP_CIPHER_CTX_copy(ctx, from))
+    {
+        EVP_CIPHER_CTX_free(ctx);
+        internal::api("AES-256 context copy", 0);
+    }
+    return ctx;
+}
+
+/**
+ * Run the keyed @a ctx over @a size bytes, from counter block @a iv.
+ * Setting only the IV keeps the expanded key.
+ */
+void ctr_xor(EVP_CIPHER_CTX* ctx, unsigned char const* in, unsigned char* out, size_t size,
+             unsigned char const* iv)
+{
+    internal::api("AES-256 counter", EVP_EncryptInit_ex(ctx, nullptr, nullptr, nullptr, iv));
+    while (size > 0)
+    {
+        int chunk = int(std::min<size_t>(size, INT_MAX & ~15));
+        int len = 0;
+        internal::api("AES-256 encrypt", EVP_EncryptUpdate(ctx, out, &len, in, chunk));
+        in += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+} // anonymous namespace
+
+aes_256_ctr::aes_256_ctr(byte_array const& key)
+    : keyed_(nullptr)
+    , context_(nullptr)
+    , impl_(dispatch::selected(dispatch::primitive::aes_256_ctr))
+{
+    assert(key.size() == key_size);
+    unsigned char const* k = (unsigned char const*)key.const_data();
+    if (impl_ != dispatch::impl::portable) {
+        aesni::expand_key_256(k, round_keys_);
+        return;
+    }
+    keyed_ = EVP_CIPHER_CTX_new();
+    if (!keyed_ or !EVP_EncryptInit_ex(keyed_, EVP_aes_256_ctr(), nullptr, k, nullptr))
+    {
+        EVP_CIPHER_CTX_free(keyed_);
+        internal::api("AES-256 key setup", 0);
+    }
+    try {
+        context_ = copy_context(keyed_);
+    } catch (...) {
+        EVP_CIPHER_CTX_free(keyed_);
+        throw;
+    }
+}
+
+aes_256_ctr::aes_256_ctr(aes_256_ctr const& other)
+    : keyed_(nullptr)
+    , context_(nullptr)
+    , impl_(other.impl_)
+{
+    std::copy(other.round_keys_, other.round_keys_ + sizeof(round_keys_), round_keys_);
+    if (other.keyed_)
+    {
+        keyed_ = copy_context(other.keyed_);
+        try {
+            context_ = copy_context(keyed_);
+        } catch (...) {
+            EVP_CIPHER_CTX_free(keyed_);
+            throw;
+        }
+    }
+}
+
+aes_256_ctr::~aes_256_ctr()
+{
+    EVP_CIPHER_CTX_free(context_); // Both cleanse the expanded key.
+    EVP_CIPHER_CTX_free(keyed_);
+    crypto::cleanse(round_keys_); // Do not leave keys lying around.
+}
+
+byte_array aes_256_ctr::encrypt(byte_array const& in, std::string iv)
+{
+    assert(iv.length() == iv_size);
+    byte_array out;
+    out.resize(in.size());
+    encrypt((unsigned char const*)in.const_data(), (unsigned char*)out.data(), in.size(),
+        (unsigned char const*)iv.data());
+    return out;
+}
+
+void aes_256_ctr::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
+{
+    assert(in == out or in + size <= out or out + size <= in);
+    if (impl_ == dispatch::impl::vaes) {
+        aesni::ctr128_xor_vaes(round_keys_, 14, in, out, size, iv);
+        return;
+    }
+    if (impl_ == dispatch::impl::aesni) {
+        aesni::ctr128_xor(round_keys_, 14, in, out, size, iv);
+        return;
+    }
+
+    // Concurrent callers, e.g. parallel_ctr workers, run on their own copy of the key.
+    std::unique_lock<std::mutex> guard(context_lock_, std::try_to_lock);
+    if (guard.owns_lock()) {
+        ctr_xor(context_, in, out, size, iv);
+        return;
+    }
+    std::unique_ptr<EVP_CIPHER_CTX, void (*)(EVP_CIPHER_CTX*)> ctx(copy_context(keyed_),
+                                                                 EVP_CIPHER_CTX_free);
+    ctr_xor(ctx.get(), in, out, size, iv);
+}
+
+void aes_256_ctr::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv, uint64_t ic) const
+{
+    unsigned char ctr[iv_size];
+    std::copy(iv, iv + iv_size, ctr);
+    advance_counter(ctr, ic);
+    encrypt(in, out, size, ctr);
+}
+
+size_t aes_256_ctr::encrypt(packet* packets, size_t count) const
+{
+    size_t done = 0;
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].ok = internal::valid(packets[i]);
+        if (packets[i].ok) {
+            ++done;
+        }
+    }
+
+    if (impl_ != dispatch::impl::portable) {
+        aesni::ctr128_xor_batch(round_keys_, 14, packets, count);
+        return done;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        if (packets[i].ok) {
+            encrypt(packets[i].in, packets[i].out, packets[i].size, packets[i].iv);
+        }
+    }
+    return done;
+}
+
+} // crypto namespace
@@ -0,0 +1,526 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <cassert>
+#include <cstdint>
+#include "aes_ni.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KRYPTO_HAVE_AESNI 1
+#include <immintrin.h>
+#define AESNI_TARGET __attribute__((target("aes,sse4.1")))
+#define VAES_TARGET __attribute__((target("aes,sse4.1,avx512f,vaes")))
+#endif
+
+namespace crypto {
+namespace aesni {
+
+#if KRYPTO_HAVE_AESNI
+
+namespace {
+
+const int lanes = 8;
+const int wide_lanes = 16; // four ZMM registers of four blocks each
+
+AESNI_TARGET inline __m128i
+expand_step(__m128i key, __m128i assist)
+{
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+/// Encrypt @a n (at most lanes) blocks in place, interleaved round by round.
+AESNI_TARGET inline void
+encrypt_blocks(__m128i const* rk, int rounds, __m128i* b, int n)
+{
+    for (int i = 0; i < n; ++i)
+        b[i] = _mm_xor_si128(b[i], rk[0]);
+    for (int r = 1; r < rounds; ++r)
+        for (int i = 0; i < n; ++i)
+            b[i] = _mm_aesenc_si128(b[i], rk[r]);
+    for (int i = 0; i < n; ++i)
+        b[i] = _mm_aesenclast_si128(b[i], rk[rounds]);
+}
+
+/// Decrypt @a n (at most lanes) blocks in place with the inverse schedule.
+AESNI_TARGET inline void
+decrypt_blocks(__m128i const* dk, int rounds, __m128i* b, int n)
+{
+    for (int i = 0; i < n; ++i)
+        b[i] = _mm_xor_si128(b[i], dk[0]);
+    for (int r = 1; r < rounds; ++r)
+        for (int i = 0; i < n; ++i)
+            b[i] = _mm_aesdec_si128(b[i], dk[r]);
+    for (int i = 0; i < n; ++i)
+        b[i] = _mm_aesdeclast_si128(b[i], dk[rounds]);
+}
+
+AESNI_TARGET inline void
+xor_block(__m128i ks, unsigned char const* in, unsigned char* out, size_t n)
+{
+    if (n == 16) {
+        __m128i d = _mm_loadu_si128((__m128i const*)in);
+        _mm_storeu_si128((__m128i*)out, _mm_xor_si128(d, ks));
+        return;
+    }
+    alignas(16) unsigned char k[16];
+    _mm_store_si128((__m128i*)k, ks);
+    for (size_t i = 0; i < n; ++i)
+        out[i] = in[i] ^ k[i];
+}
+
+inline uint32_t load_be32(unsigned char const* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t load_be64(unsigned char const* p)
+{
+    return (uint64_t(load_be32(p)) << 32) | load_be32(p + 4);
+}
+
+/// Counter blocks with a 32-bit big-endian counter in the last word (libsodium aes128ctr).
+struct counter32
+{
+    __m128i base;
+    uint32_t ctr;
+
+    AESNI_TARGET counter32(unsigned char const* iv)
+        : base(_mm_loadu_si128((__m128i const*)iv))
+        , ctr(load_be32(iv + 12))
+    {}
+
+    AESNI_TARGET inline __m128i next() {
+        return _mm_insert_epi32(base, int(__builtin_bswap32(ctr++)), 3);
+    }
+};
+
+/// Counter blocks with the whole IV as a 128-bit big-endian counter (OpenSSL, NIST SP 800-38A).
+struct counter128
+{
+    uint64_t hi, lo;
+
+    counter128(unsigned char const* iv)
+        : hi(load_be64(iv))
+        , lo(load_be64(iv + 8))
+    {}
+
+    AESNI_TARGET inline __m128i next() {
+        __m128i b = _mm_set_epi64x(int64_t(__builtin_bswap64(lo)), int64_t(__builtin_bswap64(hi)));
+        if (++lo == 0)
+            ++hi;
+        return b;
+    }
+};
+
+/// Bulk CTR, sixteen blocks per iteration with VAES on 512-bit registers.
+/// Processes whole 256-byte chunks only; returns the number of bytes done.
+template <typename Counter>
+VAES_TARGET size_t
+ctr_xor_wide(__m128i const* rk, int rounds,
+             unsigned char const* in, unsigned char* out, size_t size, Counter& ctr)
+{
+    __m512i k[15];
+    for (int r = 0; r <= rounds; ++r)
+        k[r] = _mm512_maskz_broadcast_i32x4(0xffff, rk[r]);
+
+    size_t done = 0;
+    alignas(64) __m128i c[wide_lanes];
+    while (size - done >= wide_lanes * 16)
+    {
+        for (int i = 0; i < wide_lanes; ++i)
+            c[i] = ctr.next();
+        __m512i b0 = _mm512_xor_si512(_mm512_load_si512(c + 0), k[0]);
+        __m512i b1 = _mm512_xor_si512(_mm512_load_si512(c + 4), k[0]);
+        __m512i b2 = _mm512_xor_si512(_mm512_load_si512(c + 8), k[0]);
+        __m512i b3 = _mm512_xor_si512(_mm512_load_si512(c + 12), k[0]);
+        for (int r = 1; r < rounds; ++r) {
+            b0 = _mm512_aesenc_epi128(b0, k[r]);
+            b1 = _mm512_aesenc_epi128(b1, k[r]);
+            b2 = _mm512_aesenc_epi128(b2, k[r]);
+            b3 = _mm512_aesenc_epi128(b3, k[r]);
+        }
+        b0 = _mm512_aesenclast_epi128(b0, k[rounds]);
+        b1 = _mm512_aesenclast_epi128(b1, k[rounds]);
+        b2 = _mm512_aesenclast_epi128(b2, k[rounds]);
+        b3 = _mm512_aesenclast_epi128(b3, k[rounds]);
+
+        unsigned char const* i = in + done;
+        unsigned char* o = out + done;
+        _mm512_storeu_si512(o + 0, _mm512_xor_si512(b0, _mm512_loadu_si512(i + 0)));
+        _mm512_storeu_si512(o + 64, _mm512_xor_si512(b1, _mm512_loadu_si512(i + 64)));
+        _mm512_storeu_si512(o + 128, _mm512_xor_si512(b2, _mm512_loadu_si512(i + 128)));
+        _mm512_storeu_si512(o + 192, _mm512_xor_si512(b3, _mm512_loadu_si512(i + 192)));
+        done += wide_lanes * 16;
+    }
+    return done;
+}
+
+template <typename Counter>
+AESNI_TARGET void
+ctr_xor(__m128i const* rk, int rounds,
+        unsigned char const* in, unsigned char* out, size_t size, Counter& ctr)
+{
+    __m128i b[lanes];
+
+    while (size > 0)
+    {
+        size_t blocks = (size + 15) / 16;
+        int n = blocks < size_t(lanes) ? int(blocks) : lanes;
+        for (int i = 0; i < n; ++i)
+            b[i] = ctr.next();
+        encrypt_blocks(rk, rounds, b, n);
+        for (int i = 0; i < n; ++i)
+        {
+            size_t chunk = size < 16 ? size : 16;
+            xor_block(b[i], in, out, chunk);
+            in += chunk;
+            out += chunk;
+            size -= chunk;
+        }
+    }
+}
+
+template <typename Counter>
+AESNI_TARGET void
+ctr_xor(unsigned char const* schedule, int rounds, bool wide,
+        unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    __m128i const* rk = (__m128i const*)schedule;
+    Counter ctr(iv);
+
+    if (wide and size >= wide_lanes * 16)
+    {
+        size_t done = ctr_xor_wide(rk, rounds, in, out, size, ctr);
+        in += done;
+        out += done;
+        size -= done;
+    }
+    ctr_xor(rk, rounds, in, out, size, ctr);
+}
+
+template <typename Counter>
+AESNI_TARGET void
+ctr_xor_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count)
+{
+    struct job {
+        unsigned char const* in;
+        unsigned char* out;
+        size_t size;
+    };
+
+    __m128i const* rk = (__m128i const*)schedule;
+    __m128i b[lanes];
+    job jobs[lanes];
+    int n = 0;
+
+    for (size_t p = 0; p < count; ++p)
+    {
+        if (!packets[p].ok)
+            continue;
+
+        Counter ctr(packets[p].iv);
+
+        for (size_t off = 0; off < packets[p].size; off += 16)
+        {
+            size_t rest = packets[p].size - off;
+            jobs[n].in = packets[p].in + off;
+            jobs[n].out = packets[p].out + off;
+            jobs[n].size = rest < 16 ? rest : 16;
+            b[n] = ctr.next();
+
+            if (++n == lanes)
+            {
+                encrypt_blocks(rk, rounds, b, n);
+                for (int i = 0; i < n; ++i)
+                    xor_block(b[i], jobs[i].in, jobs[i].out, jobs[i].size);
+                n = 0;
+            }
+        }
+    }
+
+    if (n > 0)
+    {
+        encrypt_blocks(rk, rounds, b, n);
+        for (int i = 0; i < n; ++i)
+            xor_block(b[i], jobs[i].in, jobs[i].out, jobs[i].size);
+    }
+}
+
+} // anonymous namespace
+
+AESNI_TARGET void
+expand_key_128(unsigned char const* key, unsigned char* schedule)
+{
+#define KEY_128_STEP(i, rcon) \
+    rk[i] = expand_step(rk[i-1], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i-1], rcon), 0xff))
+
+    __m128i* rk = (__m128i*)schedule;
+    rk[0] = _mm_loadu_si128((__m128i const*)key);
+    KEY_128_STEP(1, 0x01);
+    KEY_128_STEP(2, 0x02);
+    KEY_128_STEP(3, 0x04);
+    KEY_128_STEP(4, 0x08);
+    KEY_128_STEP(5, 0x10);
+    KEY_128_STEP(6, 0x20);
+    KEY_128_STEP(7, 0x40);
+    KEY_128_STEP(8, 0x80);
+    KEY_128_STEP(9, 0x1b);
+    KEY_128_STEP(10, 0x36);
+
+#undef KEY_128_STEP
+}
+
+AESNI_TARGET void
+expand_key_256(unsigned char const* key, unsigned char* schedule)
+{
+    // Even round keys mix in RotWord/SubWord with rcon, odd ones SubWord only.
+#define KEY_256_STEP(i, rcon) \
+    rk[i] = expand_step(rk[i-2], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i-1], rcon), 0xff)); \
+    if (i < 14) \
+        rk[i+1] = expand_step(rk[i-1], _mm_shuffle_epi32(_mm_aeskeygenassist_si128(rk[i], 0), 0xaa))
+
+    __m128i* rk = (__m128i*)schedule;
+    rk[0] = _mm_loadu_si128((__m128i const*)key);
+    rk[1] = _mm_loadu_si128((__m128i const*)(key + 16));
+    KEY_256_STEP(2, 0x01);
+    KEY_256_STEP(4, 0x02);
+    KEY_256_STEP(6, 0x04);
+    KEY_256_STEP(8, 0x08);
+    KEY_256_STEP(10, 0x10);
+    KEY_256_STEP(12, 0x20);
+    KEY_256_STEP(14, 0x40);
+
+#undef KEY_256_STEP
+}
+
+AESNI_TARGET void
+invert_key(unsigned char const* schedule, int rounds, unsigned char* inverse)
+{
+    __m128i const* rk = (__m128i const*)schedule;
+    __m128i* dk = (__m128i*)inverse;
+    dk[0] = rk[rounds];
+    for (int r = 1; r < rounds; ++r)
+        dk[r] = _mm_aesimc_si128(rk[rounds - r]);
+    dk[rounds] = rk[0];
+}
+
+void ctr32_xor(unsigned char const* schedule, int rounds,
+               unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    ctr_xor<counter32>(schedule, rounds, false, in, out, size, iv);
+}
+
+void ctr128_xor(unsigned char const* schedule, int rounds,
+                unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    ctr_xor<counter128>(schedule, rounds, false, in, out, size, iv);
+}
+
+void ctr32_xor_vaes(unsigned char const* schedule, int rounds,
+                    unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    ctr_xor<counter32>(schedule, rounds, true, in, out, size, iv);
+}
+
+void ctr128_xor_vaes(unsigned char const* schedule, int rounds,
+                     unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    ctr_xor<counter128>(schedule, rounds, true, in, out, size, iv);
+}
+
+void ctr32_xor_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count)
+{
+    ctr_xor_batch<counter32>(schedule, rounds, packets, count);
+}
+
+void ctr128_xor_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count)
+{
+    ctr_xor_batch<counter128>(schedule, rounds, packets, count);
+}
+
+AESNI_TARGET void
+cbc_encrypt(unsigned char const* schedule, int rounds,
+            unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    assert(size % 16 == 0);
+    __m128i const* rk = (__m128i const*)schedule;
+    __m128i chain = _mm_loadu_si128((__m128i const*)iv);
+
+    for (size_t off = 0; off < size; off += 16)
+    {
+        chain = _mm_xor_si128(chain, _mm_loadu_si128((__m128i const*)(in + off)));
+        encrypt_blocks(rk, rounds, &chain, 1);
+        _mm_storeu_si128((__m128i*)(out + off), chain);
+    }
+}
+
+AESNI_TARGET void
+cbc_decrypt(unsigned char const* inverse, int rounds,
+            unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv)
+{
+    assert(size % 16 == 0);
+    __m128i const* dk = (__m128i const*)inverse;
+    __m128i chain = _mm_loadu_si128((__m128i const*)iv);
+    __m128i c[lanes], b[lanes];
+
+    while (size > 0)
+    {
+        size_t blocks = size / 16;
+        int n = blocks < size_t(lanes) ? int(blocks) : lanes;
+        // Every ciphertext block is loaded before any output is stored, so in-place works.
+        for (int i = 0; i < n; ++i)
+            b[i] = c[i] = _mm_loadu_si128((__m128i const*)in + i);
+        decrypt_blocks(dk, rounds, b, n);
+        _mm_storeu_si128((__m128i*)out, _mm_xor_si128(b[0], chain));
+        for (int i = 1; i < n; ++i)
+            _mm_storeu_si128((__m128i*)out + i, _mm_xor_si128(b[i], c[i - 1]));
+        chain = c[n - 1];
+        in += n * 16;
+        out += n * 16;
+        size -= n * 16;
+    }
+}
+
+AESNI_TARGET void
+cbc_encrypt_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count)
+{
+    struct lane {
+        unsigned char const* in;
+        unsigned char* out;
+        size_t left;
+    };
+
+    __m128i const* rk = (__m128i const*)schedule;
+    __m128i chain[lanes];
+    lane jobs[lanes];
+    size_t next = 0;
+
+    // Next pending packet to start a lane with, or nullptr when all are taken.
+    auto pending = [&]() -> packet const* {
+        while (next < count)
+        {
+            packet const& p = packets[next++];
+            if (p.ok and p.size != 0) {
+                assert(p.size % 16 == 0);
+                return &p;
+            }
+        }
+        return nullptr;
+    };
+
+    int n = 0;
+    for (packet const* p; n < lanes and (p = pending()); ++n)
+    {
+        jobs[n] = lane{p->in, p->out, p->size};
+        chain[n] = _mm_loadu_si128((__m128i const*)p->iv);
+    }
+
+    while (n > 0)
+    {
+        for (int i = 0; i < n; ++i)
+            chain[i] = _mm_xor_si128(chain[i], _mm_loadu_si128((__m128i const*)jobs[i].in));
+        encrypt_blocks(rk, rounds, chain, n);
+        for (int i = 0; i < n; ++i)
+        {
+            _mm_storeu_si128((__m128i*)jobs[i].out, chain[i]);
+            jobs[i].in += 16;
+            jobs[i].out += 16;
+            jobs[i].left -= 16;
+        }
+        // Retire finished lanes, backfilling from the queue or else from the last lane.
+        for (int i = 0; i < n; )
+        {
+            if (jobs[i].left != 0) {
+                ++i;
+            } else if (packet const* p = pending()) {
+                jobs[i] = lane{p->in, p->out, p->size};
+                chain[i] = _mm_loadu_si128((__m128i const*)p->iv);
+            } else {
+                --n;
+                jobs[i] = jobs[n];
+                chain[i] = chain[n];
+            }
+        }
+    }
+}
+
+#else // KRYPTO_HAVE_AESNI
+
+void expand_key_128(unsigned char const*, unsigned char*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void expand_key_256(unsigned char const*, unsigned char*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void invert_key(unsigned char const*, int, unsigned char*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr32_xor(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+               unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr128_xor(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+                unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr32_xor_vaes(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+                    unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr128_xor_vaes(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+                     unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr32_xor_batch(unsigned char const*, int, packet*, size_t)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void ctr128_xor_batch(unsigned char const*, int, packet*, size_t)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void cbc_encrypt(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+                 unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void cbc_decrypt(unsigned char const*, int, unsigned char const*, unsigned char*, size_t,
+                 unsigned char const*)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+void cbc_encrypt_batch(unsigned char const*, int, packet*, size_t)
+{
+    assert(!"AES-NI is not available on this architecture");
+}
+
+#endif // KRYPTO_HAVE_AESNI
+
+} // aesni namespace
+} // crypto namespace
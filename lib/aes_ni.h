@@ -0,0 +1,65 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// AES-NI kernels. Internal to libkrypto, dispatch::supported() tells which ones may run.
+//
+#pragma once
+
+#include <cstddef>
+#include "krypto/packet.h"
+
+namespace crypto {
+namespace aesni {
+
+/// Sizes of expanded key schedules; the number of rounds is 10 and 14 respectively.
+const size_t schedule_128_size = 11 * 16;
+const size_t schedule_256_size = 15 * 16;
+
+/// Expand a 16-byte @a key into @a schedule (schedule_128_size bytes, 16-byte aligned).
+void expand_key_128(unsigned char const* key, unsigned char* schedule);
+
+/// Expand a 32-byte @a key into @a schedule (schedule_256_size bytes, 16-byte aligned).
+void expand_key_256(unsigned char const* key, unsigned char* schedule);
+
+/// Turn the encryption @a schedule into a decryption schedule for the Equivalent Inverse Cipher.
+void invert_key(unsigned char const* schedule, int rounds, unsigned char* inverse);
+
+/// CTR mode with a 32-bit big-endian counter in the last word of @a iv, 8 blocks at a time.
+void ctr32_xor(unsigned char const* schedule, int rounds,
+               unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+
+/// CTR mode with the whole @a iv as a 128-bit big-endian counter.
+void ctr128_xor(unsigned char const* schedule, int rounds,
+                unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+
+/// The same CTR modes, running bulk data sixteen blocks at a time with VAES.
+void ctr32_xor_vaes(unsigned char const* schedule, int rounds,
+                    unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+void ctr128_xor_vaes(unsigned char const* schedule, int rounds,
+                     unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+
+/// CTR over all packets with ok set, interleaving blocks of different packets
+/// so that small packets still fill the 8-block pipeline.
+void ctr32_xor_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count);
+void ctr128_xor_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count);
+
+/// CBC encryption of one message, @a size a multiple of 16. Serial by nature.
+void cbc_encrypt(unsigned char const* schedule, int rounds,
+                 unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+
+/// CBC decryption with the inverse schedule, eight blocks in flight.
+/// @a in and @a out may be the same pointer.
+void cbc_decrypt(unsigned char const* inverse, int rounds,
+                 unsigned char const* in, unsigned char* out, size_t size, unsigned char const* iv);
+
+/// CBC encryption of all packets with ok set, one message per lane, so that up to
+/// eight independent chains share the pipeline.
+void cbc_encrypt_batch(unsigned char const* schedule, int rounds, packet* packets, size_t count);
+
+} // aesni namespace
+} // crypto namespace
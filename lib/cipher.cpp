@@ -0,0 +1,118 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <climits>
+#include "krypto/cipher.h"
+
+namespace crypto {
+
+namespace {
+
+EVP_CIPHER const* gcm_for_key(size_t key_size)
+{
+    switch (key_size)
+    {
+        case 16: return EVP_aes_128_gcm();
+        case 24: return EVP_aes_192_gcm();
+        case 32: return EVP_aes_256_gcm();
+    }
+    throw std::runtime_error("cipher: key must be 16, 24 or 32 bytes");
+}
+
+} // anonymous namespace
+
+// OpenSSL's GCM uses the stitched AES-NI/PCLMUL code when the CPU has it,
+// so every transform() encrypts and authenticates the chunk in a single pass.
+void cipher::init(unsigned char const* key, size_t key_size,
+                  unsigned char const* iv, size_t iv_size, bool encrypt)
+{
+    EVP_CIPHER const* type = gcm_for_key(key_size);
+    assert(iv_size > 0);
+
+    encrypting_ = encrypt;
+    context_ = EVP_CIPHER_CTX_new();
+    internal::api("cipher context", context_ != nullptr);
+
+    try {
+        internal::api("cipher init", EVP_CipherInit_ex(context_, type, nullptr, nullptr, nullptr, encrypt));
+        internal::api("cipher iv length",
+            EVP_CIPHER_CTX_ctrl(context_, EVP_CTRL_GCM_SET_IVLEN, int(iv_size), nullptr));
+        internal::api("cipher key", EVP_CipherInit_ex(context_, nullptr, nullptr, key, iv, encrypt));
+    } catch (...) {
+        EVP_CIPHER_CTX_free(context_);
+        throw;
+    }
+}
+
+cipher::~cipher()
+{
+    EVP_CIPHER_CTX_free(context_); // Cleanses the expanded key and GCM state.
+}
+
+void cipher::set_seal(unsigned char const* seal, size_t size)
+{
+    assert(!encrypting_);
+    // Called from the constructor, so release the context on failure.
+    if (size != seal_size or
+        !EVP_CIPHER_CTX_ctrl(context_, EVP_CTRL_GCM_SET_TAG, int(size), (void*)seal))
+    {
+        EVP_CIPHER_CTX_free(context_);
+        throw std::runtime_error("cipher: seal must be 16 bytes");
+    }
+}
+
+void cipher::associate_data(unsigned char const* data, size_t size)
+{
+    while (size > 0)
+    {
+        int chunk = int(std::min<size_t>(size, INT_MAX));
+        int len = 0;
+        internal::api("cipher associated data",
+            EVP_CipherUpdate(context_, nullptr, &len, data, chunk));
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+void cipher::transform(unsigned char const* in, unsigned char* out, size_t size)
+{
+    while (size > 0)
+    {
+        int chunk = int(std::min<size_t>(size, INT_MAX & ~15));
+        int len = 0;
+        internal::api("cipher transform", EVP_CipherUpdate(context_, out, &len, in, chunk));
+        assert(len == chunk); // GCM is a stream mode, nothing is buffered.
+        in += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+void cipher::seal(unsigned char* seal, size_t size)
+{
+    assert(encrypting_);
+    // Same rule as set_seal(): no truncated tags either way.
+    if (size != seal_size) {
+        throw std::runtime_error("cipher: seal must be 16 bytes");
+    }
+    int len = 0;
+    internal::api("cipher finalize", EVP_CipherFinal_ex(context_, nullptr, &len));
+    internal::api("cipher seal",
+        EVP_CIPHER_CTX_ctrl(context_, EVP_CTRL_GCM_GET_TAG, int(size), seal));
+}
+
+void cipher::verify()
+{
+    assert(!encrypting_);
+    unsigned char scratch[seal_size];
+    int len = 0;
+    internal::api("cipher verify", EVP_CipherFinal_ex(context_, scratch, &len));
+}
+
+} // crypto namespace
@@ -2,57 +2,120 @@
 // Do not use crypto_sign_edwards25519sha512batch as it was a prototype,
 // see libsodium for why.
 
+#include <algorithm>
 #include "krypto/krypto.h"
 #include "krypto/crypto_box_sign.h"
 #include "krypto/sha256_hash.h"
+#include "arsenal/byte_array_wrap.h"
+#include "arsenal/flurry.h"
+#include "arsenal/logging.h"
 
 namespace crypto {
 
+namespace {
+
+/// Signatures per piece of work in verify_batch(); a verify is ~50us, a wakeup a few.
+const size_t batch_segment = 16;
+
+} // anonymous namespace
+
 nacl_sign_key::nacl_sign_key()
 {
-    // pk = crypto_sign_edwards25519sha512batch_keypair(&sk);
+    pk.resize(public_key_size);
+    sk.resize(secret_key_size);
+    crypto_sign_keypair((unsigned char*)pk.data(), (unsigned char*)sk.data());
+    set_type(public_and_private);
 }
 
 // public_key,flag[,private_key]
 nacl_sign_key::nacl_sign_key(byte_array const& keys)
 {
-    // keys >> pk >> has_sk;
-    // if (has_sk) {
-    //     keys >> sk;
-    // }
+    byte_array_iwrap<flurry::iarchive> read(keys);
+    bool has_sk;
+
+    read.archive() >> pk >> has_sk;
+    if (has_sk) {
+        read.archive() >> sk;
+    }
+
+    if (pk.size() != public_key_size or (has_sk and sk.size() != secret_key_size)) {
+        logger::warning() << "Invalid Ed25519 key";
+        return; // stays invalid
+    }
+
+    set_type(has_sk ? public_and_private : public_only);
 }
 
 nacl_sign_key::~nacl_sign_key()
 {
-    // cleanse(sk);
-    // cleanse(pk);
+    cleanse(sk.as_vector());
 }
 
-byte_array nacl_sign_key::id() const
+byte_array nacl_sign_key::encode_public_key() const
 {
-    assert(type() != invalid);
-    return byte_array(sha256::hash(public_key()));
-}
-
-byte_array nacl_sign_key::public_key() const {
-    return pk;
+    byte_array data;
+    {
+        byte_array_owrap<flurry::oarchive> write(data);
+        write.archive() << pk << false;
+    }
+    return data;
 }
 
-byte_array nacl_sign_key::private_key() const {
-    return sk;
+byte_array nacl_sign_key::private_key() const
+{
+    assert(type() == public_and_private);
+    byte_array data;
+    {
+        byte_array_owrap<flurry::oarchive> write(data);
+        write.archive() << pk << true << sk;
+    }
+    return data;
 }
 
 byte_array nacl_sign_key::sign(byte_array const& digest) const
 {
-    return byte_array();
-    // return byte_array(crypto_sign_edwards25519sha512batch_sign(digest, sk));
+    // Without a secret key sk is empty; do not let libsodium read past it.
+    if (type() != public_and_private) {
+        throw std::runtime_error("nacl_sign_key: cannot sign without a private key");
+    }
+
+    byte_array signature;
+    signature.resize(signature_size);
+    crypto_sign_detached((unsigned char*)signature.data(), nullptr,
+                         (unsigned char const*)digest.const_data(), digest.size(),
+                         (unsigned char const*)sk.const_data());
+    return signature;
 }
 
 bool nacl_sign_key::verify(byte_array const& digest, byte_array const& signature) const
 {
-    // duh!
-    // crypto_sign_edwards25519sha512batch_open(signature, pk);
-    return false;
+    if (type() == invalid or signature.size() != signature_size) {
+        return false;
+    }
+    return crypto_sign_verify_detached((unsigned char const*)signature.const_data(),
+                                       (unsigned char const*)digest.const_data(), digest.size(),
+                                       (unsigned char const*)pk.const_data()) == 0;
+}
+
+size_t nacl_sign_key::verify_batch(signed_digest* items, size_t count, thread_pool& pool)
+{
+    auto verify_segment = [items, count](size_t segment) {
+        size_t end = std::min(count, (segment + 1) * batch_segment);
+        for (size_t i = segment * batch_segment; i < end; ++i) {
+            items[i].ok = items[i].key->verify(*items[i].digest, *items[i].signature);
+        }
+    };
+
+    size_t segments = (count + batch_segment - 1) / batch_segment;
+    if (segments < 2) {
+        for (size_t s = 0; s < segments; ++s) {
+            verify_segment(s);
+        }
+    } else {
+        pool.parallel_for(segments, verify_segment);
+    }
+
+    return std::count_if(items, items + count, [](signed_digest const& d) { return d.ok; });
 }
 
 void nacl_sign_key::dump() const
@@ -0,0 +1,371 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <atomic>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <cstring>
+#include <openssl/evp.h>
+#include <crypto_hash_sha256.h>
+#include <crypto_hash_sha512.h>
+#include "krypto/dispatch.h"
+#include "krypto/krypto.h"
+#include "arsenal/logging.h"
+#include "sha_ni.h"
+#include "sha256_mb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace crypto {
+namespace dispatch {
+
+namespace {
+
+const int primitive_count = 7;
+
+char const* const primitive_names[primitive_count] = {
+    "aes_128_ctr", "aes_256_ctr", "aes_256_cbc", "xsalsa20", "sha256", "sha512", "sha256_batch"
+};
+
+const impl all_impls[] = {
+    impl::portable, impl::openssl, impl::aesni, impl::vaes, impl::shani, impl::avx2, impl::avx512
+};
+
+static_assert(sizeof(crypto_hash_sha256_state) <= hash_state_size, "hash_state_size too small");
+static_assert(sizeof(crypto_hash_sha512_state) <= hash_state_size, "hash_state_size too small");
+
+cpu_features probe()
+{
+    cpu_features f = {};
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return f;
+
+    f.sse41 = ecx & bit_SSE4_1;
+    f.aesni = ecx & bit_AES;
+    f.pclmul = ecx & bit_PCLMUL;
+
+    // AVX state must be enabled by the OS before any of the wide extensions are usable.
+    unsigned xcr0 = 0;
+    if (ecx & bit_OSXSAVE) {
+        unsigned hi;
+        __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(hi) : "c"(0));
+    }
+    bool os_avx = (xcr0 & 0x06) == 0x06;
+    bool os_avx512 = (xcr0 & 0xe6) == 0xe6;
+
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        f.avx2 = os_avx and (ebx & bit_AVX2);
+        f.avx512f = os_avx512 and (ebx & bit_AVX512F);
+        f.vaes = f.avx512f and f.aesni and (ecx & (1u << 9));
+        f.sha = ebx & (1u << 29);
+    }
+#endif
+    return f;
+}
+
+impl best(primitive p)
+{
+    // One SHA-NI message at a time outruns eight AVX2 lanes; only AVX-512 beats it.
+    if (p == primitive::sha256_batch and supported(primitive::sha256, impl::shani)
+        and not supported(p, impl::avx512)) {
+        return impl::portable;
+    }
+    // OpenSSL's EVP digests are left out: a heap-allocated context per hash costs
+    // more than libsodium's plain state saves on short messages.
+    for (impl i : { impl::avx512, impl::vaes, impl::aesni, impl::shani, impl::avx2 }) {
+        if (supported(p, i)) {
+            return i;
+        }
+    }
+    return impl::portable;
+}
+
+bool parse(std::string const& text, impl& out)
+{
+    for (impl i : all_impls) {
+        if (text == name(i)) {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+struct bindings
+{
+    std::atomic<int> current[primitive_count];
+
+    bindings()
+    {
+        for (int p = 0; p < primitive_count; ++p) {
+            current[p] = int(best(primitive(p)));
+        }
+        if (char const* spec = std::getenv("KRYPTO_IMPL")) {
+            apply(spec);
+        }
+    }
+
+    // Comma-separated list of "impl" (all primitives that can use it) or "primitive=impl".
+    void apply(std::string const& spec)
+    {
+        std::istringstream in(spec);
+        std::string token;
+        while (std::getline(in, token, ','))
+        {
+            size_t eq = token.find('=');
+            std::string target = eq == std::string::npos ? "" : token.substr(0, eq);
+            std::string wanted = eq == std::string::npos ? token : token.substr(eq + 1);
+
+            impl i;
+            if (!parse(wanted, i)) {
+                logger::warning() << "KRYPTO_IMPL: unknown implementation " << wanted;
+                continue;
+            }
+
+            bool matched = false;
+            for (int p = 0; p < primitive_count; ++p)
+            {
+                if (!target.empty() and target != primitive_names[p]) {
+                    continue;
+                }
+                matched = true;
+                if (supported(primitive(p), i)) {
+                    current[p] = int(i);
+                } else if (!target.empty()) {
+                    logger::warning() << "KRYPTO_IMPL: " << wanted << " cannot run "
+                                      << target << " on this host, ignored";
+                }
+            }
+            if (!matched) {
+                logger::warning() << "KRYPTO_IMPL: unknown primitive " << target;
+            }
+        }
+    }
+};
+
+bindings& table()
+{
+    static bindings b;
+    return b;
+}
+
+//=================================================================================================
+// Hash kernels
+//=================================================================================================
+
+// The OpenSSL kernels keep an EVP_MD_CTX pointer in the state.
+EVP_MD_CTX*& evp_state(void* s) { return *(EVP_MD_CTX**)s; }
+EVP_MD_CTX* evp_state(void const* s) { return *(EVP_MD_CTX* const*)s; }
+
+void evp_init(void* s, EVP_MD const* md)
+{
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx or !EVP_DigestInit_ex(ctx, md, nullptr))
+    {
+        EVP_MD_CTX_free(ctx);
+        internal::api("EVP digest init", 0);
+    }
+    evp_state(s) = ctx;
+}
+
+void evp_update(void* s, unsigned char const* d, size_t n)
+{
+    internal::api("EVP digest update", EVP_DigestUpdate(evp_state(s), d, n));
+}
+
+void evp_final(void* s, unsigned char* md)
+{
+    internal::api("EVP digest final", EVP_DigestFinal_ex(evp_state(s), md, nullptr));
+}
+
+void evp_reset(void* s, EVP_MD const* md)
+{
+    internal::api("EVP digest init", EVP_DigestInit_ex(evp_state(s), md, nullptr));
+}
+
+void evp_copy(void* to, void const* from)
+{
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (!ctx or !EVP_MD_CTX_copy_ex(ctx, evp_state(from)))
+    {
+        EVP_MD_CTX_free(ctx);
+        internal::api("EVP digest copy", 0);
+    }
+    evp_state(to) = ctx;
+}
+
+void evp_discard(void* s)
+{
+    EVP_MD_CTX_free(evp_state(s));
+    evp_state(s) = nullptr;
+}
+
+void evp_hash(EVP_MD const* type, unsigned char const* d, size_t n, unsigned char* md)
+{
+    internal::api("EVP digest", EVP_Digest(d, n, md, nullptr, type, nullptr));
+}
+
+void openssl_sha256_init(void* s) { evp_init(s, EVP_sha256()); }
+void openssl_sha256_reset(void* s) { evp_reset(s, EVP_sha256()); }
+void openssl_sha256_hash(unsigned char const* d, size_t n, unsigned char* md) { evp_hash(EVP_sha256(), d, n, md); }
+
+void openssl_sha512_init(void* s) { evp_init(s, EVP_sha512()); }
+void openssl_sha512_reset(void* s) { evp_reset(s, EVP_sha512()); }
+void openssl_sha512_hash(unsigned char const* d, size_t n, unsigned char* md) { evp_hash(EVP_sha512(), d, n, md); }
+
+// The other kernels keep plain data in the state.
+void pod_copy(void* to, void const* from) { std::memcpy(to, from, hash_state_size); }
+void pod_discard(void*) {}
+
+void sodium_sha256_init(void* s) { crypto_hash_sha256_init((crypto_hash_sha256_state*)s); }
+void sodium_sha256_update(void* s, unsigned char const* d, size_t n) { crypto_hash_sha256_update((crypto_hash_sha256_state*)s, d, n); }
+void sodium_sha256_final(void* s, unsigned char* md) { crypto_hash_sha256_final((crypto_hash_sha256_state*)s, md); }
+void sodium_sha256_hash(unsigned char const* d, size_t n, unsigned char* md) { crypto_hash_sha256(md, d, n); }
+
+void sodium_sha512_init(void* s) { crypto_hash_sha512_init((crypto_hash_sha512_state*)s); }
+void sodium_sha512_update(void* s, unsigned char const* d, size_t n) { crypto_hash_sha512_update((crypto_hash_sha512_state*)s, d, n); }
+void sodium_sha512_final(void* s, unsigned char* md) { crypto_hash_sha512_final((crypto_hash_sha512_state*)s, md); }
+void sodium_sha512_hash(unsigned char const* d, size_t n, unsigned char* md) { crypto_hash_sha512(md, d, n); }
+
+const hash_kernel openssl_sha256_kernel = {
+    openssl_sha256_init, evp_update, evp_final, openssl_sha256_reset, openssl_sha256_hash,
+    evp_copy, evp_discard
+};
+const hash_kernel openssl_sha512_kernel = {
+    openssl_sha512_init, evp_update, evp_final, openssl_sha512_reset, openssl_sha512_hash,
+    evp_copy, evp_discard
+};
+const hash_kernel sodium_sha256_kernel = {
+    sodium_sha256_init, sodium_sha256_update, sodium_sha256_final, sodium_sha256_init,
+    sodium_sha256_hash, pod_copy, pod_discard
+};
+const hash_kernel sodium_sha512_kernel = {
+    sodium_sha512_init, sodium_sha512_update, sodium_sha512_final, sodium_sha512_init,
+    sodium_sha512_hash, pod_copy, pod_discard
+};
+const hash_kernel shani_sha256_kernel = {
+    shani::sha256_init, shani::sha256_update, shani::sha256_final, shani::sha256_init,
+    shani::sha256_hash, pod_copy, pod_discard
+};
+
+void portable_sha256_batch(unsigned char const* const* data, size_t const* sizes, size_t count,
+                           unsigned char* digests)
+{
+    hash_kernel const& k = sha256();
+    for (size_t i = 0; i < count; ++i) {
+        k.hash(data[i], sizes[i], digests + 32 * i);
+    }
+}
+
+} // anonymous namespace
+
+cpu_features const& cpu()
+{
+    static const cpu_features features = probe();
+    return features;
+}
+
+impl selected(primitive p)
+{
+    return impl(table().current[int(p)].load(std::memory_order_relaxed));
+}
+
+bool supported(primitive p, impl i)
+{
+    cpu_features const& f = cpu();
+    switch (p)
+    {
+        case primitive::aes_128_ctr:
+        case primitive::aes_256_ctr:
+            return i == impl::portable
+                or (i == impl::aesni and f.aesni and f.sse41)
+                or (i == impl::vaes and f.aesni and f.sse41 and f.vaes);
+        case primitive::aes_256_cbc:
+            return i == impl::portable or (i == impl::aesni and f.aesni and f.sse41);
+        case primitive::xsalsa20:
+            return i == impl::portable;
+        case primitive::sha256:
+            return i == impl::portable or i == impl::openssl
+                or (i == impl::shani and f.sha and f.sse41);
+        case primitive::sha512:
+            return i == impl::portable or i == impl::openssl;
+        case primitive::sha256_batch:
+            return i == impl::portable
+                or (i == impl::avx2 and f.avx2)
+                or (i == impl::avx512 and f.avx512f);
+    }
+    return false;
+}
+
+bool force(primitive p, impl i)
+{
+    if (!supported(p, i)) {
+        return false;
+    }
+    table().current[int(p)] = int(i);
+    return true;
+}
+
+char const* name(impl i)
+{
+    switch (i)
+    {
+        case impl::portable: return "portable";
+        case impl::openssl:  return "openssl";
+        case impl::aesni:    return "aesni";
+        case impl::vaes:     return "vaes";
+        case impl::shani:    return "shani";
+        case impl::avx2:     return "avx2";
+        case impl::avx512:   return "avx512";
+    }
+    return "unknown";
+}
+
+hash_kernel const& sha256()
+{
+    switch (selected(primitive::sha256))
+    {
+        case impl::shani:   return shani_sha256_kernel;
+        case impl::openssl: return openssl_sha256_kernel;
+        default:            return sodium_sha256_kernel;
+    }
+}
+
+hash_kernel const& sha512()
+{
+    return selected(primitive::sha512) == impl::openssl ? openssl_sha512_kernel : sodium_sha512_kernel;
+}
+
+hash_batch_kernel sha256_batch()
+{
+    switch (selected(primitive::sha256_batch))
+    {
+        case impl::avx512: return sha256_mb::hash_x16;
+        case impl::avx2:   return sha256_mb::hash_x8;
+        default:           return portable_sha256_batch;
+    }
+}
+
+hash_batch_from_kernel sha256_batch_from()
+{
+    switch (selected(primitive::sha256_batch))
+    {
+        case impl::avx512: return sha256_mb::hash_x16_from;
+        case impl::avx2:   return sha256_mb::hash_x8_from;
+        default:           return nullptr;
+    }
+}
+
+} // dispatch namespace
+} // crypto namespace
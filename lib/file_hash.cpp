@@ -0,0 +1,134 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "krypto/file_hash.h"
+
+namespace crypto {
+
+namespace {
+
+/// Bytes mapped at a time; large enough to amortise mmap, small enough to bound the footprint.
+const size_t window_size = 16 << 20;
+
+/// Buffer for files that cannot be mapped.
+const size_t read_size = 1 << 20;
+
+void fail(std::string const& what, std::string const& path)
+{
+    throw std::runtime_error(what + " " + path + ": " + std::strerror(errno));
+}
+
+struct file_closer
+{
+    int fd;
+    ~file_closer() { ::close(fd); }
+};
+
+/// Hash a regular file through a sliding mapping. Returns false if mmap is not possible.
+bool hash_mapped(int fd, std::string const& path, size_t size, sha256::context& ctx)
+{
+    for (size_t offset = 0; offset < size; offset += window_size)
+    {
+        size_t length = std::min(window_size, size - offset);
+        void* window = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, off_t(offset));
+        if (window == MAP_FAILED)
+        {
+            if (offset == 0) {
+                return false;
+            }
+            fail("cannot map", path);
+        }
+        ::madvise(window, length, MADV_SEQUENTIAL);
+
+        // Start reading the next window in the background while this one is hashed.
+        size_t next = offset + length;
+        if (next < size) {
+            ::posix_fadvise(fd, off_t(next), off_t(std::min(window_size, size - next)),
+                            POSIX_FADV_WILLNEED);
+        }
+
+        ctx.update((unsigned char const*)window, length);
+        ::munmap(window, length);
+    }
+    return true;
+}
+
+void hash_read(int fd, std::string const& path, sha256::context& ctx)
+{
+    void* memory = nullptr;
+    if (::posix_memalign(&memory, 4096, read_size) != 0) {
+        throw std::bad_alloc();
+    }
+    std::unique_ptr<unsigned char, void (*)(void*)> buffer((unsigned char*)memory, std::free);
+
+    for (;;)
+    {
+        ssize_t n = ::read(fd, buffer.get(), read_size);
+        if (n < 0)
+        {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("cannot read", path);
+        }
+        if (n == 0) {
+            break;
+        }
+        ctx.update(buffer.get(), size_t(n));
+    }
+}
+
+} // anonymous namespace
+
+sha256::digest hash_file(std::string const& path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        fail("cannot open", path);
+    }
+    file_closer closer{fd};
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        fail("cannot stat", path);
+    }
+
+    sha256::context ctx;
+    bool mapped = false;
+    if (S_ISREG(st.st_mode))
+    {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        mapped = hash_mapped(fd, path, size_t(st.st_size), ctx);
+    }
+    if (!mapped) {
+        hash_read(fd, path, ctx);
+    }
+    return ctx.finalize();
+}
+
+byte_array sign_file(sign_key const& key, std::string const& path)
+{
+    return key.sign(sha256::to_byte_array(hash_file(path)));
+}
+
+bool verify_file(sign_key const& key, std::string const& path, byte_array const& signature)
+{
+    return key.verify(sha256::to_byte_array(hash_file(path)), signature);
+}
+
+} // crypto namespace
@@ -0,0 +1,155 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <crypto_hash_sha256.h>
+#include "krypto/hmac.h"
+
+namespace crypto {
+
+namespace {
+
+/// Messages per pass through the multi-buffer kernel.
+const size_t batch_group = 64;
+
+/// SHA-256 state words after hashing the single block @a pad.
+void midstate(unsigned char const* pad, uint32_t* out)
+{
+    crypto_hash_sha256_state state;
+    crypto_hash_sha256_init(&state);
+    crypto_hash_sha256_update(&state, pad, sha256::block_size);
+    std::memcpy(out, state.state, sizeof(state.state));
+    auto wrap = boost::asio::buffer((void*)&state, sizeof(state));
+    crypto::cleanse(wrap);
+}
+
+} // anonymous namespace
+
+hmac::hmac(unsigned char const* key, size_t size)
+{
+    unsigned char pad[sha256::block_size] = {0};
+
+    // Keys longer than a block are hashed first, shorter ones are zero-padded.
+    if (size > sizeof(pad)) {
+        dispatch::sha256().hash(key, size, pad);
+    } else if (size > 0) {
+        std::memcpy(pad, key, size);
+    }
+
+    for (unsigned char& c : pad) {
+        c ^= 0x36;
+    }
+    inner_.update(pad, sizeof(pad));
+    midstate(pad, inner_mid_);
+
+    for (unsigned char& c : pad) {
+        c ^= 0x36 ^ 0x5c;
+    }
+    outer_.update(pad, sizeof(pad));
+    midstate(pad, outer_mid_);
+
+    crypto::cleanse(pad);
+}
+
+hmac::~hmac()
+{
+    crypto::cleanse(inner_mid_);
+    crypto::cleanse(outer_mid_);
+}
+
+void hmac::finalize(sha256::context& ctx, unsigned char* out) const
+{
+    finish(ctx, out);
+    ctx = inner_;
+}
+
+void hmac::finish(sha256::context& ctx, unsigned char* out) const
+{
+    sha256::digest inner = ctx.finalize();
+
+    sha256::context outer(outer_);
+    outer.update(inner.data(), inner.size());
+    outer.finalize(out);
+    crypto::cleanse(inner);
+}
+
+void hmac::sign(unsigned char const* data, size_t size, unsigned char* out) const
+{
+    sha256::context ctx(inner_);
+    ctx.update(data, size);
+
+    sha256::digest full;
+    finish(ctx, full.data());
+    std::memcpy(out, full.data(), tag_size);
+    crypto::cleanse(full);
+}
+
+bool hmac::verify(unsigned char const* data, size_t size, unsigned char const* mac) const
+{
+    tag expected;
+    sign(data, size, expected.data());
+    return CRYPTO_memcmp(expected.data(), mac, tag_size) == 0;
+}
+
+void hmac::sign(unsigned char const* const* data, size_t const* sizes, size_t count,
+                unsigned char* tags) const
+{
+    dispatch::hash_batch_from_kernel batch = dispatch::sha256_batch_from();
+    if (!batch)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            sign(data[i], sizes[i], tags + i * tag_size);
+        }
+        return;
+    }
+
+    // Inner hashes of a group side by side, then the outer hashes of their digests.
+    unsigned char inner[batch_group * sha256::digest_size];
+    unsigned char outer[batch_group * sha256::digest_size];
+    unsigned char const* digests[batch_group];
+    size_t digest_sizes[batch_group];
+    for (size_t first = 0; first < count; first += batch_group)
+    {
+        size_t n = std::min(batch_group, count - first);
+        batch(inner_mid_, sha256::block_size, data + first, sizes + first, n, inner);
+        for (size_t i = 0; i < n; ++i)
+        {
+            digests[i] = inner + i * sha256::digest_size;
+            digest_sizes[i] = sha256::digest_size;
+        }
+        batch(outer_mid_, sha256::block_size, digests, digest_sizes, n, outer);
+        for (size_t i = 0; i < n; ++i) {
+            std::memcpy(tags + (first + i) * tag_size, outer + i * sha256::digest_size, tag_size);
+        }
+    }
+    crypto::cleanse(inner);
+    crypto::cleanse(outer);
+}
+
+size_t hmac::verify(unsigned char const* const* data, size_t const* sizes, size_t count,
+                    unsigned char const* tags, bool* ok) const
+{
+    unsigned char expected[batch_group * tag_size];
+    size_t good = 0;
+    for (size_t first = 0; first < count; first += batch_group)
+    {
+        size_t n = std::min(batch_group, count - first);
+        sign(data + first, sizes + first, n, expected);
+        for (size_t i = 0; i < n; ++i)
+        {
+            ok[first + i] = CRYPTO_memcmp(expected + i * tag_size,
+                                          tags + (first + i) * tag_size, tag_size) == 0;
+            good += ok[first + i];
+        }
+    }
+    return good;
+}
+
+} // crypto namespace
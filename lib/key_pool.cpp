@@ -0,0 +1,169 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include "krypto/key_pool.h"
+#include "arsenal/logging.h"
+
+namespace crypto {
+
+key_pool::key_pool(size_t threads)
+{
+    for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i) {
+        workers_.emplace_back([this] { worker(); });
+    }
+}
+
+key_pool::~key_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+void key_pool::add(std::string const& kind, size_t depth, factory make)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        kind_state& s = kinds_[kind];
+        s.make = std::move(make);
+        s.depth = depth;
+        while (s.ready.size() > depth) {
+            s.ready.pop_back();
+        }
+    }
+    wake_.notify_all();
+}
+
+key_pool::key_ptr
+key_pool::take(std::string const& kind)
+{
+    factory make;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        kind_state& s = state(kind);
+        ++s.taken;
+        if (!s.ready.empty())
+        {
+            key_ptr key = std::move(s.ready.front());
+            s.ready.pop_front();
+            wake_.notify_one();
+            return key;
+        }
+        ++s.starved;
+        make = s.make;
+    }
+    wake_.notify_one();
+    return make();
+}
+
+key_pool::key_ptr
+key_pool::try_take(std::string const& kind)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    kind_state& s = state(kind);
+    if (s.ready.empty())
+    {
+        ++s.starved;
+        return key_ptr();
+    }
+    ++s.taken;
+    key_ptr key = std::move(s.ready.front());
+    s.ready.pop_front();
+    wake_.notify_one();
+    return key;
+}
+
+key_pool::stats
+key_pool::statistics(std::string const& kind) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = kinds_.find(kind);
+    if (it == kinds_.end()) {
+        return stats{0, 0, 0};
+    }
+    return stats{it->second.taken, it->second.starved, it->second.ready.size()};
+}
+
+key_pool::kind_state&
+key_pool::state(std::string const& kind)
+{
+    auto it = kinds_.find(kind);
+    if (it == kinds_.end()) {
+        throw std::runtime_error("key_pool: unknown key kind " + kind);
+    }
+    return it->second;
+}
+
+// The kind that is emptiest relative to its depth, so one slow kind
+// does not keep the others from being refilled.
+key_pool::kind_state*
+key_pool::next_to_fill()
+{
+    kind_state* best = nullptr;
+    double best_fill = 1.0;
+    for (auto& k : kinds_)
+    {
+        kind_state& s = k.second;
+        size_t have = s.ready.size() + s.generating;
+        if (have >= s.depth) {
+            continue;
+        }
+        double fill = double(have) / double(s.depth);
+        if (!best or fill < best_fill)
+        {
+            best = &s;
+            best_fill = fill;
+        }
+    }
+    return best;
+}
+
+void key_pool::worker()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        kind_state* s = nullptr;
+        wake_.wait(lock, [this, &s] { return stopping_ or (s = next_to_fill()) != nullptr; });
+        if (stopping_) {
+            return;
+        }
+
+        ++s->generating;
+        factory make = s->make;
+        lock.unlock();
+        key_ptr key;
+        try {
+            key = make();
+        } catch (std::exception const& e) {
+            logger::warning() << "key_pool: key generation failed: " << e.what();
+        }
+        lock.lock();
+        --s->generating;
+
+        if (!key)
+        {
+            // Do not spin on a broken factory; take() still generates inline.
+            wake_.wait_for(lock, std::chrono::seconds(1), [this] { return stopping_; });
+            continue;
+        }
+        if (s->ready.size() < s->depth) {
+            s->ready.push_back(std::move(key));
+        }
+    }
+}
+
+} // crypto namespace
@@ -0,0 +1,256 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include "krypto/key_registry.h"
+
+namespace crypto {
+
+namespace {
+
+/// Candidates per piece of work in find_signer(); an RSA verify is tens of microseconds.
+const size_t trial_segment = 16;
+
+const size_t npos = size_t(-1);
+
+/// Leading 64 bits of @a bytes, big-endian, padded with @a fill.
+uint64_t leading_bits(byte_array const& bytes, unsigned char fill)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < 8; ++i) {
+        value = (value << 8) | (i < bytes.size() ? (unsigned char)bytes.const_data()[i] : fill);
+    }
+    return value;
+}
+
+bool starts_with(byte_array const& id, byte_array const& prefix)
+{
+    return prefix.size() <= id.size()
+        and std::memcmp(id.const_data(), prefix.const_data(), prefix.size()) == 0;
+}
+
+} // anonymous namespace
+
+key_registry::key_registry(size_t expected)
+{
+    // Keep the table at most 70% full.
+    size_t capacity = 16;
+    shift_ = 64 - 4;
+    while (capacity * 7 < expected * 10)
+    {
+        capacity *= 2;
+        --shift_;
+    }
+    slots_.resize(capacity);
+}
+
+bool key_registry::insert(key_ptr key)
+{
+    if (!key or key->type() == sign_key::invalid) {
+        return false;
+    }
+    byte_array const& id = key->id();
+    uint64_t hash = leading_bits(id, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (locate(hash, id) != npos) {
+        return false;
+    }
+    if ((size_ + 1) * 10 > slots_.size() * 7) {
+        grow();
+    }
+    if (distance_to_free(hash) > max_probe) {
+        return false;
+    }
+    place(slot{hash, std::move(key)});
+    ++size_;
+    return true;
+}
+
+bool key_registry::erase(byte_array const& id)
+{
+    uint64_t hash = leading_bits(id, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t hole = locate(hash, id);
+    if (hole == npos) {
+        return false;
+    }
+    slots_[hole].key.reset();
+
+    // Shift later members of the cluster back into the hole, unless their home
+    // lies after it; no tombstones are left behind.
+    for (size_t j = (hole + 1) & mask(); slots_[j].key; j = (j + 1) & mask())
+    {
+        size_t h = home(slots_[j].hash);
+        bool stays = hole <= j ? (hole < h and h <= j) : (hole < h or h <= j);
+        if (!stays)
+        {
+            slots_[hole] = std::move(slots_[j]);
+            slots_[j].key.reset();
+            hole = j;
+        }
+    }
+    --size_;
+    return true;
+}
+
+key_registry::key_ptr
+key_registry::find(byte_array const& id) const
+{
+    uint64_t hash = leading_bits(id, 0);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t i = locate(hash, id);
+    return i == npos ? key_ptr() : slots_[i].key;
+}
+
+std::vector<key_registry::key_ptr>
+key_registry::find_prefix(byte_array const& prefix) const
+{
+    uint64_t low = leading_bits(prefix, 0x00);
+    uint64_t high = leading_bits(prefix, 0xff);
+    std::vector<key_ptr> result;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Keys with home slots first..last sit between first and the end of the
+    // cluster that contains last.
+    size_t first = home(low);
+    size_t span = home(high) - first;
+    for (size_t step = 0, i = first; step < slots_.size(); ++step, i = (i + 1) & mask())
+    {
+        slot const& s = slots_[i];
+        if (!s.key)
+        {
+            if (step > span) {
+                break;
+            }
+            continue;
+        }
+        if (s.hash >= low and s.hash <= high and starts_with(s.key->id(), prefix)) {
+            result.push_back(s.key);
+        }
+    }
+    return result;
+}
+
+size_t key_registry::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_;
+}
+
+key_registry::key_ptr
+key_registry::find_signer(byte_array const& digest, byte_array const& signature,
+                          thread_pool& pool) const
+{
+    std::vector<key_ptr> candidates;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        candidates.reserve(size_);
+        for (slot const& s : slots_) {
+            if (s.key) {
+                candidates.push_back(s.key);
+            }
+        }
+    }
+    return find_signer(candidates, digest, signature, pool);
+}
+
+key_registry::key_ptr
+key_registry::find_signer(std::vector<key_ptr> const& candidates,
+                          byte_array const& digest, byte_array const& signature,
+                          thread_pool& pool)
+{
+    // Lowest index that verified so far; npos sorts after every index.
+    std::atomic<size_t> found{npos};
+
+    auto try_segment = [&](size_t segment) {
+        size_t end = std::min(candidates.size(), (segment + 1) * trial_segment);
+        for (size_t i = segment * trial_segment; i < end; ++i)
+        {
+            if (found.load(std::memory_order_relaxed) < i) {
+                return; // an earlier candidate already matched
+            }
+            bool valid = false;
+            try {
+                valid = candidates[i]->verify(digest, signature);
+            } catch (std::exception const&) {
+                valid = false;
+            }
+            if (valid)
+            {
+                size_t seen = found.load();
+                while (i < seen and !found.compare_exchange_weak(seen, i)) {}
+                return;
+            }
+        }
+    };
+
+    size_t segments = (candidates.size() + trial_segment - 1) / trial_segment;
+    if (segments < 2) {
+        for (size_t s = 0; s < segments; ++s) {
+            try_segment(s);
+        }
+    } else {
+        pool.parallel_for(segments, try_segment);
+    }
+
+    size_t i = found.load();
+    return i == npos ? key_ptr() : candidates[i];
+}
+
+size_t key_registry::locate(uint64_t hash, byte_array const& id) const
+{
+    size_t i = home(hash);
+    for (size_t step = 0; step <= longest_ and slots_[i].key; ++step, i = (i + 1) & mask()) {
+        if (slots_[i].hash == hash and slots_[i].key->id() == id) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+/// Slots between the home of @a hash and the next free one, counted up to max_probe + 1.
+size_t key_registry::distance_to_free(uint64_t hash) const
+{
+    size_t step = 0;
+    for (size_t i = home(hash); slots_[i].key and step <= max_probe; i = (i + 1) & mask()) {
+        ++step;
+    }
+    return step;
+}
+
+void key_registry::place(slot&& s)
+{
+    size_t start = home(s.hash);
+    size_t i = start;
+    while (slots_[i].key) {
+        i = (i + 1) & mask();
+    }
+    longest_ = std::max(longest_, (i - start) & mask());
+    slots_[i] = std::move(s);
+}
+
+void key_registry::grow()
+{
+    std::vector<slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    --shift_;
+    longest_ = 0;
+    for (slot& s : old) {
+        if (s.key) {
+            place(std::move(s));
+        }
+    }
+}
+
+} // crypto namespace
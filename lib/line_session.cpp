@@ -0,0 +1,107 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "krypto/line_session.h"
+#include "krypto/dispatch.h"
+
+namespace crypto {
+
+namespace {
+
+/// SHA-256(secret | first | second), the telehash line key.
+byte_array line_key(byte_array const& secret, byte_array const& first, byte_array const& second)
+{
+    dispatch::hash_kernel const& sha = dispatch::sha256();
+    alignas(16) unsigned char state[dispatch::hash_state_size];
+    sha.init(state);
+    sha.update(state, (unsigned char const*)secret.const_data(), secret.size());
+    sha.update(state, (unsigned char const*)first.const_data(), first.size());
+    sha.update(state, (unsigned char const*)second.const_data(), second.size());
+
+    byte_array key;
+    key.resize(line_session::key_size);
+    sha.final(state, (unsigned char*)key.data());
+    sha.discard(state);
+    crypto::cleanse(state);
+    return key;
+}
+
+/// Derive a line key and set up the cipher with it, leaving no copies of the key behind.
+aes_256_ctr line_cipher(byte_array const& secret, byte_array const& first, byte_array const& second)
+{
+    byte_array key = line_key(secret, first, second);
+    aes_256_ctr cipher(key);
+    crypto::cleanse(key.as_vector());
+    return cipher;
+}
+
+} // anonymous namespace
+
+line_session::line_session(byte_array const& ecdhe_secret,
+                           byte_array const& my_line_id, byte_array const& their_line_id)
+    : encrypt_cipher_(line_cipher(ecdhe_secret, my_line_id, their_line_id))
+    , decrypt_cipher_(line_cipher(ecdhe_secret, their_line_id, my_line_id))
+{
+    assert(my_line_id.size() == line_id_size);
+    assert(their_line_id.size() == line_id_size);
+    crypto::fill_random(iv_prefix_);
+}
+
+line_session::line_session(byte_array const& encrypt_key, byte_array const& decrypt_key)
+    : encrypt_cipher_(encrypt_key)
+    , decrypt_cipher_(decrypt_key)
+{
+    crypto::fill_random(iv_prefix_);
+}
+
+void line_session::next_iv(unsigned char* iv)
+{
+    // Never step the counter past the last packet number, so that it cannot
+    // wrap around to a nonce that was already used.
+    uint64_t n = sent_.load(std::memory_order_relaxed);
+    do {
+        internal::api("line nonce space exhausted", n != UINT64_MAX);
+    } while (!sent_.compare_exchange_weak(n, n + 1, std::memory_order_relaxed));
+
+    iv[0] = iv_prefix_[0];
+    iv[1] = iv_prefix_[1];
+    iv[2] = iv_prefix_[2];
+    iv[3] = iv_prefix_[3];
+    for (int i = 11; i >= 4; --i, n >>= 8) {
+        iv[i] = n & 0xff;
+    }
+    iv[12] = iv[13] = iv[14] = iv[15] = 0;
+}
+
+void line_session::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+                           unsigned char* iv)
+{
+    // The block counter must not carry into the packet number.
+    assert(uint64_t(size) < (uint64_t(1) << 32) * aes_256_ctr::block_size);
+    next_iv(iv);
+    encrypt_cipher_.encrypt(in, out, size, iv);
+}
+
+void line_session::decrypt(unsigned char const* in, unsigned char* out, size_t size,
+                           unsigned char const* iv) const
+{
+    decrypt_cipher_.decrypt(in, out, size, iv);
+}
+
+size_t line_session::encrypt(packet* packets, unsigned char* ivs, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        unsigned char* iv = ivs + i * iv_size;
+        next_iv(iv);
+        packets[i].iv = iv;
+    }
+    return encrypt_cipher_.encrypt(packets, count);
+}
+
+} // crypto namespace
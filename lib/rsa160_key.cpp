@@ -6,8 +6,13 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
+// The low-level RSA key accessors are deprecated as of OpenSSL 3.0.
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <openssl/crypto.h>
 #include <openssl/sha.h>
-#include <openssl/err.h>
 #include "krypto/sha256_hash.h"
 #include "krypto/rsa160_key.h"
 #include "krypto/utils.h"
@@ -19,30 +24,131 @@
 
 namespace crypto {
 
+namespace {
+
+// DER DigestInfo header for SHA-256 (RFC 3447, section 9.2), as RSA_sign() builds it.
+const unsigned char sha256_digest_info[] = {
+    0x30, 0x31, 0x30, 0x0d, 0x06, 0x09, 0x60, 0x86, 0x48, 0x01,
+    0x65, 0x03, 0x04, 0x02, 0x01, 0x05, 0x00, 0x04, 0x20
+};
+
+const size_t encoded_digest_size = sizeof(sha256_digest_info) + SHA256_DIGEST_LENGTH;
+
+// EMSA-PKCS1-v1_5 encoding of a SHA-256 digest into @a size bytes:
+// 00 01 FF..FF 00 DigestInfo digest, with at least eight bytes of FF.
+bool encode_digest(byte_array const& digest, unsigned char* em, size_t size)
+{
+    if (digest.size() != SHA256_DIGEST_LENGTH or size < encoded_digest_size + 11) {
+        return false;
+    }
+    size_t info = size - encoded_digest_size;
+    em[0] = 0x00;
+    em[1] = 0x01;
+    std::memset(em + 2, 0xff, info - 3);
+    em[info - 1] = 0x00;
+    std::memcpy(em + info, sha256_digest_info, sizeof(sha256_digest_info));
+    std::memcpy(em + size - SHA256_DIGEST_LENGTH, digest.const_data(), SHA256_DIGEST_LENGTH);
+    return true;
+}
+
+bool usable(BIGNUM const* bn)
+{
+    return bn and !BN_is_zero(bn) and !BN_is_negative(bn);
+}
+
+BN_MONT_CTX* montgomery(BIGNUM const* mod, BN_CTX* ctx)
+{
+    BN_MONT_CTX* mont = BN_MONT_CTX_new();
+    if (mont and !BN_MONT_CTX_set(mont, mod, ctx))
+    {
+        BN_MONT_CTX_free(mont);
+        return nullptr;
+    }
+    return mont;
+}
+
+} // anonymous namespace
+
+/**
+ * Private-key working state owned by one signing thread at a time:
+ * blinding factors for n and a BN_CTX for scratch numbers.
+ */
+struct rsa160_key::blinding
+{
+    BN_CTX* ctx;
+    BN_BLINDING* factors;
+
+    blinding(BIGNUM const* e, BIGNUM const* n, BN_MONT_CTX* mont_n)
+        : ctx(BN_CTX_new())
+        , factors(nullptr)
+    {
+        if (ctx) {
+            // The modulus is copied, never written.
+            factors = BN_BLINDING_create_param(nullptr, e, const_cast<BIGNUM*>(n), ctx,
+                                               BN_mod_exp_mont, mont_n);
+        }
+    }
+
+    ~blinding()
+    {
+        BN_BLINDING_free(factors);
+        BN_CTX_free(ctx);
+    }
+};
+
 rsa160_key::rsa160_key(RSA *rsa)
     : rsa_(rsa)
-{}
+{
+    BIGNUM const* d = nullptr;
+    RSA_get0_key(rsa_, nullptr, nullptr, &d);
+    set_type(d ? public_and_private : public_only);
+    precompute();
+}
 
 rsa160_key::rsa160_key(byte_array const& key)
+    : rsa_(RSA_new())
 {
-    rsa_ = RSA_new();
-    assert(rsa_);
+    internal::api("RSA allocation", rsa_ != nullptr);
 
-    byte_array_iwrap<flurry::iarchive> read(key);
-    bool has_private_key;
+    BIGNUM *n = nullptr, *e = nullptr, *d = nullptr, *p = nullptr, *q = nullptr;
+    BIGNUM *dmp1 = nullptr, *dmq1 = nullptr, *iqmp = nullptr;
+    bool has_private_key = false;
 
-    read.archive() >> rsa_->n >> rsa_->e >> has_private_key;
-    if (has_private_key) {
-        read.archive() >> rsa_->d >> rsa_->p >> rsa_->q >> rsa_->dmp1 >> rsa_->dmq1 >> rsa_->iqmp;
+    try {
+        byte_array_iwrap<flurry::iarchive> read(key);
+        read.archive() >> n >> e >> has_private_key;
+        if (has_private_key) {
+            read.archive() >> d >> p >> q >> dmp1 >> dmq1 >> iqmp;
+        }
+    } catch (std::exception const& ex) {
+        logger::warning() << "Truncated RSA key - " << ex.what();
     }
 
-    if (has_private_key)
-        set_type(public_and_private);
-    else
-        set_type(public_only);
+    // RSA_set0_*() take ownership only when they succeed; precompute() finds what is missing.
+    if (!RSA_set0_key(rsa_, n, e, d))
+    {
+        BN_free(n);
+        BN_free(e);
+        BN_clear_free(d);
+    }
+    if (!RSA_set0_factors(rsa_, p, q))
+    {
+        BN_clear_free(p);
+        BN_clear_free(q);
+    }
+    if (!RSA_set0_crt_params(rsa_, dmp1, dmq1, iqmp))
+    {
+        BN_clear_free(dmp1);
+        BN_clear_free(dmq1);
+        BN_clear_free(iqmp);
+    }
+
+    set_type(has_private_key ? public_and_private : public_only);
+    precompute();
 }
 
 rsa160_key::rsa160_key(int bits, unsigned e)
+    : rsa_(RSA_new())
 {
     if (bits == 0) {
         bits = 2048;
@@ -55,16 +161,28 @@ rsa160_key::rsa160_key(int bits, unsigned e)
     }
 
     // Generate a new RSA key given those parameters
-    rsa_ = RSA_generate_key(bits, e, nullptr, nullptr);
-
-    assert(rsa_);
-    assert(rsa_->d);
+    BIGNUM* exponent = BN_new();
+    bool ok = rsa_ and exponent and BN_set_word(exponent, e)
+        and RSA_generate_key_ex(rsa_, bits, exponent, nullptr);
+    BN_free(exponent);
+    if (!ok)
+    {
+        RSA_free(rsa_);
+        throw std::runtime_error("Cannot generate RSA private key");
+    }
 
     set_type(public_and_private);
+    precompute();
 }
 
 rsa160_key::~rsa160_key()
 {
+    for (blinding* b : blindings_) {
+        delete b;
+    }
+    BN_MONT_CTX_free(mont_n_);
+    BN_MONT_CTX_free(mont_p_);
+    BN_MONT_CTX_free(mont_q_);
     if (rsa_) {
         RSA_free(rsa_);
         rsa_ = nullptr;
@@ -72,30 +190,16 @@ rsa160_key::~rsa160_key()
 }
 
 byte_array
-rsa160_key::id() const
+rsa160_key::encode_public_key() const
 {
-    assert(type() != invalid);
+    BIGNUM const *n, *e;
+    RSA_get0_key(rsa_, &n, &e, nullptr);
 
-    crypto::hash::value hash = sha256::hash(public_key());
-
-    byte_array id(hash);
-    // Only return 160 bits of key identity information,
-    // because this method's security may be limited by the SHA-1 hash
-    // used in the RSA-OAEP padding process.
-    id.resize(160/8);
-
-    return id;
-}
-
-byte_array
-rsa160_key::public_key() const
-{
-    assert(type() != invalid);
     byte_array data;
     {
         byte_array_owrap<flurry::oarchive> write(data);
         // Write the public part of the key
-        write.archive() << rsa_->n << rsa_->e << false;
+        write.archive() << n << e << false;
     }
     return data;
 }
@@ -104,12 +208,17 @@ byte_array
 rsa160_key::private_key() const
 {
     assert(type() == public_and_private);
+    BIGNUM const *n, *e, *d, *p, *q, *dmp1, *dmq1, *iqmp;
+    RSA_get0_key(rsa_, &n, &e, &d);
+    RSA_get0_factors(rsa_, &p, &q);
+    RSA_get0_crt_params(rsa_, &dmp1, &dmq1, &iqmp);
+
     byte_array data;
     {
         byte_array_owrap<flurry::oarchive> write(data);
         // Write the public and private parts of the key
-        write.archive() << rsa_->n << rsa_->e << true;
-        write.archive() << rsa_->d << rsa_->p << rsa_->q << rsa_->dmp1 << rsa_->dmq1 << rsa_->iqmp;
+        write.archive() << n << e << true;
+        write.archive() << d << p << q << dmp1 << dmq1 << iqmp;
     }
     return data;
 }
@@ -117,42 +226,183 @@ rsa160_key::private_key() const
 byte_array
 rsa160_key::sign(byte_array const& digest) const
 {
-    assert(type() != invalid);
+    if (type() != public_and_private) {
+        throw std::runtime_error("rsa160_key: cannot sign without a private key");
+    }
     assert(digest.size() == SHA256_DIGEST_LENGTH);
 
+    BIGNUM const *n, *e, *p, *q, *dmp1, *dmq1, *iqmp;
+    RSA_get0_key(rsa_, &n, &e, nullptr);
+    RSA_get0_factors(rsa_, &p, &q);
+    RSA_get0_crt_params(rsa_, &dmp1, &dmq1, &iqmp);
+
+    size_t size = BN_num_bytes(n);
     byte_array signature;
-    unsigned siglen = RSA_size(rsa_);
-    signature.resize(siglen);
+    signature.resize(size);
+    unsigned char* out = (unsigned char*)signature.data();
 
-    if (!RSA_sign(NID_sha256,
-            (unsigned char*)digest.data(), SHA256_DIGEST_LENGTH,
-            (unsigned char*)signature.data(), &siglen, rsa_))
+    blinding* b = acquire_blinding();
+    if (!b)
     {
-        logger::fatal() << "RSA signing error - " << ERR_error_string(ERR_get_error(), nullptr);
+        logger::warning() << "RSA signing error - cannot set up blinding";
+        return byte_array();
     }
+    BN_CTX* ctx = b->ctx;
+    BN_CTX_start(ctx);
+    BIGNUM* c = BN_CTX_get(ctx);
+    BIGNUM* m1 = BN_CTX_get(ctx);
+    BIGNUM* m2 = BN_CTX_get(ctx);
+    BIGNUM* t = BN_CTX_get(ctx);
+
+    // Encode and blind: c = em * A^e mod n.
+    bool ok = t
+        and encode_digest(digest, out, size)
+        and BN_bin2bn(out, int(size), c)
+        and BN_BLINDING_convert_ex(c, nullptr, b->factors, ctx)
+        and BN_mod(m1, c, p, ctx)
+        and BN_mod(m2, c, q, ctx);
 
-    assert(siglen <= signature.size());
-    signature.resize(siglen);
+    // m1 = c^dmp1 mod p, m2 = c^dmq1 mod q, on the precomputed Montgomery forms.
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    // Both halves at once; OpenSSL 3 runs them side by side with AVX-512 IFMA.
+    ok = ok and BN_mod_exp_mont_consttime_x2(m1, m1, dmp1, p, mont_p_,
+                                             m2, m2, dmq1, q, mont_q_, ctx);
+#else
+    ok = ok and BN_mod_exp_mont_consttime(m1, m1, dmp1, p, ctx, mont_p_)
+        and BN_mod_exp_mont_consttime(m2, m2, dmq1, q, ctx, mont_q_);
+#endif
 
+    // Garner: s = m2 + q ((m1 - m2) iqmp mod p). A fault anywhere would leak the
+    // factors through s, so check s^e against c before letting it out.
+    ok = ok
+        and BN_sub(m1, m1, m2)
+        and BN_mod_mul(m1, m1, iqmp, p, ctx)
+        and BN_mul(t, m1, q, ctx)
+        and BN_add(m1, t, m2)
+        and BN_mod_exp_mont(t, m1, e, n, ctx, mont_n_)
+        and BN_cmp(t, c) == 0
+        and BN_BLINDING_invert_ex(m1, nullptr, b->factors, ctx)
+        and BN_bn2binpad(m1, out, int(size)) == int(size);
+
+    BN_CTX_end(ctx);
+    release_blinding(b);
+
+    if (!ok)
+    {
+        OPENSSL_cleanse(out, size);
+        logger::warning() << "RSA signing error";
+        return byte_array();
+    }
     return signature;
 }
 
 bool
 rsa160_key::verify(byte_array const& digest, byte_array const& signature) const
 {
-    assert(type() != invalid);
+    if (type() == invalid) {
+        return false;
+    }
     assert(digest.size() == SHA256_DIGEST_LENGTH);
 
-    int rc = RSA_verify(NID_sha256,
-            (unsigned char*)digest.data(), SHA256_DIGEST_LENGTH,
-            (unsigned char*)signature.const_data(), signature.size(), rsa_);
+    BIGNUM const *n, *e;
+    RSA_get0_key(rsa_, &n, &e, nullptr);
+    size_t size = BN_num_bytes(n);
+    if (signature.size() != size) {
+        return false;
+    }
+
+    // s^e mod n must give back the encoded digest.
+    std::vector<unsigned char> expected(size), recovered(size);
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* s = BN_bin2bn((unsigned char const*)signature.const_data(), int(size), nullptr);
+    bool valid = ctx and s
+        and encode_digest(digest, expected.data(), size)
+        and BN_cmp(s, n) < 0
+        and BN_mod_exp_mont(s, s, e, n, ctx, mont_n_)
+        and BN_bn2binpad(s, recovered.data(), int(size)) == int(size)
+        and recovered == expected;
 
-    if (!rc)
+    BN_free(s);
+    BN_CTX_free(ctx);
+    return valid;
+}
+
+// Check the key fields and build the Montgomery contexts; a key that fails is left invalid.
+bool
+rsa160_key::precompute()
+{
+    BIGNUM const *n, *e, *d, *p, *q, *dmp1, *dmq1, *iqmp;
+    RSA_get0_key(rsa_, &n, &e, &d);
+    RSA_get0_factors(rsa_, &p, &q);
+    RSA_get0_crt_params(rsa_, &dmp1, &dmq1, &iqmp);
+
+    bool is_private = type() == public_and_private;
+    bool ok = usable(n) and usable(e) and BN_is_odd(n) and BN_is_odd(e)
+        and size_t(BN_num_bytes(n)) >= encoded_digest_size + 11;
+    if (ok and is_private)
+    {
+        ok = usable(d) and usable(p) and usable(q) and usable(dmp1) and usable(dmq1)
+            and usable(iqmp) and BN_is_odd(p) and BN_is_odd(q);
+        // Decoded numbers lack the flag OpenSSL sets on the secrets it generates.
+        for (BIGNUM const* secret : { d, p, q, dmp1, dmq1, iqmp }) {
+            if (secret) {
+                BN_set_flags(const_cast<BIGNUM*>(secret), BN_FLG_CONSTTIME);
+            }
+        }
+    }
+
+    BN_CTX* ctx = ok ? BN_CTX_new() : nullptr;
+    if (ok and is_private)
     {
-        logger::warning() << "RSA signature verification failed - " << ERR_error_string(ERR_get_error(), nullptr);
+        // CRT with factors that do not make up n would sign garbage.
+        BIGNUM* pq = BN_new();
+        ok = ctx and pq and BN_mul(pq, p, q, ctx) and BN_cmp(pq, n) == 0;
+        BN_free(pq);
     }
+    ok = ok and ctx and (mont_n_ = montgomery(n, ctx)) != nullptr;
+    if (ok and is_private) {
+        ok = (mont_p_ = montgomery(p, ctx)) != nullptr
+            and (mont_q_ = montgomery(q, ctx)) != nullptr;
+    }
+    BN_CTX_free(ctx);
+
+    if (!ok)
+    {
+        logger::warning() << "Invalid RSA key";
+        set_type(invalid);
+    }
+    return ok;
+}
 
-    return rc == 1;
+rsa160_key::blinding*
+rsa160_key::acquire_blinding() const
+{
+    {
+        std::lock_guard<std::mutex> lock(blindings_mutex_);
+        if (!blindings_.empty())
+        {
+            blinding* b = blindings_.back();
+            blindings_.pop_back();
+            return b;
+        }
+    }
+    // First use on this many threads at once: set up one more.
+    BIGNUM const *n, *e;
+    RSA_get0_key(rsa_, &n, &e, nullptr);
+    blinding* b = new blinding(e, n, mont_n_);
+    if (!b->factors)
+    {
+        delete b;
+        return nullptr;
+    }
+    return b;
+}
+
+void
+rsa160_key::release_blinding(blinding* b) const
+{
+    std::lock_guard<std::mutex> lock(blindings_mutex_);
+    blindings_.push_back(b);
 }
 
 void
@@ -0,0 +1,328 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include "sha256_mb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KRYPTO_HAVE_SHA256_MB 1
+#include <immintrin.h>
+#define AVX2_TARGET __attribute__((target("avx2")))
+#define AVX512_TARGET __attribute__((target("avx2,avx512f")))
+#endif
+
+namespace crypto {
+namespace sha256_mb {
+
+#if KRYPTO_HAVE_SHA256_MB
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+const unsigned char zero_block[64] = {0};
+
+inline uint32_t load_be32(unsigned char const* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+// One SHA-256 round on all lanes. Relies on add(), ror(), shr(), xor3(), ch() and maj()
+// of the enclosing ISA namespace; the caller renames the variables instead of moving them.
+#define SHA256_ROUND(a, b, c, d, e, f, g, h, t) \
+    { \
+        vec t1 = add(add(add(h, xor3(ror(e, 6), ror(e, 11), ror(e, 25))), \
+                         add(ch(e, f, g), set1(K[t]))), w[(t) & 15]); \
+        vec t2 = add(xor3(ror(a, 2), ror(a, 13), ror(a, 22)), maj(a, b, c)); \
+        d = add(d, t1); \
+        h = add(t1, t2); \
+    }
+
+// Extend the message schedule to word t (t >= 16) in the 16-word ring w.
+#define SHA256_SCHEDULE(t) \
+    { \
+        vec w15 = w[((t) - 15) & 15], w2 = w[((t) - 2) & 15]; \
+        w[(t) & 15] = add(add(w[(t) & 15], w[((t) - 7) & 15]), \
+                          add(xor3(ror(w15, 7), ror(w15, 18), shr(w15, 3)), \
+                              xor3(ror(w2, 17), ror(w2, 19), shr(w2, 10)))); \
+    }
+
+#define SHA256_EIGHT_ROUNDS(t) \
+    SHA256_ROUND(a, b, c, d, e, f, g, h, (t) + 0); \
+    SHA256_ROUND(h, a, b, c, d, e, f, g, (t) + 1); \
+    SHA256_ROUND(g, h, a, b, c, d, e, f, (t) + 2); \
+    SHA256_ROUND(f, g, h, a, b, c, d, e, (t) + 3); \
+    SHA256_ROUND(e, f, g, h, a, b, c, d, (t) + 4); \
+    SHA256_ROUND(d, e, f, g, h, a, b, c, (t) + 5); \
+    SHA256_ROUND(c, d, e, f, g, h, a, b, (t) + 6); \
+    SHA256_ROUND(b, c, d, e, f, g, h, a, (t) + 7)
+
+// Compress one block per lane. state holds word i of lane l at state[i * lanes + l];
+// only lanes with their bit set in mask are updated.
+#define SHA256_COMPRESS(lanes) \
+    vec w[16]; \
+    for (int i = 0; i < 16; ++i) \
+        w[i] = gather(blocks, 4 * i); \
+    vec a = load(state + 0 * lanes), b = load(state + 1 * lanes); \
+    vec c = load(state + 2 * lanes), d = load(state + 3 * lanes); \
+    vec e = load(state + 4 * lanes), f = load(state + 5 * lanes); \
+    vec g = load(state + 6 * lanes), h = load(state + 7 * lanes); \
+    SHA256_EIGHT_ROUNDS(0); \
+    SHA256_EIGHT_ROUNDS(8); \
+    for (int t = 16; t < 64; t += 8) \
+    { \
+        for (int i = 0; i < 8; ++i) \
+            SHA256_SCHEDULE(t + i); \
+        SHA256_EIGHT_ROUNDS(t); \
+    } \
+    vec* out[8] = { &a, &b, &c, &d, &e, &f, &g, &h }; \
+    for (int i = 0; i < 8; ++i) \
+        store_masked(state + i * lanes, add(load(state + i * lanes), *out[i]), mask)
+
+namespace x8 {
+
+using vec = __m256i;
+
+AVX2_TARGET inline vec add(vec x, vec y) { return _mm256_add_epi32(x, y); }
+AVX2_TARGET inline vec set1(uint32_t x) { return _mm256_set1_epi32(int(x)); }
+AVX2_TARGET inline vec shr(vec x, int n) { return _mm256_srli_epi32(x, n); }
+AVX2_TARGET inline vec ror(vec x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+AVX2_TARGET inline vec xor3(vec x, vec y, vec z) {
+    return _mm256_xor_si256(_mm256_xor_si256(x, y), z);
+}
+AVX2_TARGET inline vec ch(vec e, vec f, vec g) {
+    return _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+}
+AVX2_TARGET inline vec maj(vec a, vec b, vec c) {
+    return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_or_si256(a, b)));
+}
+AVX2_TARGET inline vec load(uint32_t const* p) { return _mm256_loadu_si256((vec const*)p); }
+
+AVX2_TARGET inline void store_masked(uint32_t* p, vec x, unsigned mask)
+{
+    vec lanes = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+    vec m = _mm256_cmpeq_epi32(_mm256_and_si256(set1(mask), lanes), lanes);
+    _mm256_storeu_si256((vec*)p, _mm256_blendv_epi8(load(p), x, m));
+}
+
+AVX2_TARGET inline vec gather(unsigned char const* const* blocks, int offset)
+{
+    return _mm256_set_epi32(
+        int(load_be32(blocks[7] + offset)), int(load_be32(blocks[6] + offset)),
+        int(load_be32(blocks[5] + offset)), int(load_be32(blocks[4] + offset)),
+        int(load_be32(blocks[3] + offset)), int(load_be32(blocks[2] + offset)),
+        int(load_be32(blocks[1] + offset)), int(load_be32(blocks[0] + offset)));
+}
+
+AVX2_TARGET void compress(uint32_t* state, unsigned char const* const* blocks, unsigned mask)
+{
+    SHA256_COMPRESS(8);
+}
+
+} // x8 namespace
+
+namespace x16 {
+
+using vec = __m512i;
+
+AVX512_TARGET inline vec add(vec x, vec y) { return _mm512_add_epi32(x, y); }
+AVX512_TARGET inline vec set1(uint32_t x) { return _mm512_set1_epi32(int(x)); }
+// Zero-masked forms with a full mask compile to the plain instructions; the unmasked
+// intrinsics pass GCC's _mm512_undefined_epi32() placeholder, which trips -Wuninitialized.
+AVX512_TARGET inline vec shr(vec x, int n) {
+    return _mm512_maskz_srlv_epi32(__mmask16(0xffff), x, set1(uint32_t(n)));
+}
+AVX512_TARGET inline vec ror(vec x, int n) {
+    return _mm512_maskz_rorv_epi32(__mmask16(0xffff), x, set1(uint32_t(n)));
+}
+AVX512_TARGET inline vec xor3(vec x, vec y, vec z) { return _mm512_ternarylogic_epi32(x, y, z, 0x96); }
+AVX512_TARGET inline vec ch(vec e, vec f, vec g) { return _mm512_ternarylogic_epi32(e, f, g, 0xca); }
+AVX512_TARGET inline vec maj(vec a, vec b, vec c) { return _mm512_ternarylogic_epi32(a, b, c, 0xe8); }
+AVX512_TARGET inline vec load(uint32_t const* p) { return _mm512_loadu_si512(p); }
+
+AVX512_TARGET inline void store_masked(uint32_t* p, vec x, unsigned mask)
+{
+    _mm512_mask_storeu_epi32(p, __mmask16(mask), x);
+}
+
+AVX512_TARGET inline vec gather(unsigned char const* const* blocks, int offset)
+{
+    alignas(64) uint32_t words[16];
+    for (int l = 0; l < 16; ++l)
+        words[l] = load_be32(blocks[l] + offset);
+    return _mm512_load_si512(words);
+}
+
+AVX512_TARGET void compress(uint32_t* state, unsigned char const* const* blocks, unsigned mask)
+{
+    SHA256_COMPRESS(16);
+}
+
+} // x16 namespace
+
+#undef SHA256_COMPRESS
+#undef SHA256_EIGHT_ROUNDS
+#undef SHA256_SCHEDULE
+#undef SHA256_ROUND
+
+/**
+ * Feed messages to the lanes of @a compress in groups, one block per lane per step.
+ * Full blocks are read in place; only the padded tail of each message is copied.
+ * Every lane starts from @a start, the state after @a prefix bytes.
+ */
+template <int Lanes>
+void hash_lanes(void (*compress)(uint32_t*, unsigned char const* const*, unsigned),
+                uint32_t const* start, uint64_t prefix,
+                unsigned char const* const* data, size_t const* sizes, size_t count,
+                unsigned char* digests)
+{
+    assert(prefix % 64 == 0);
+    alignas(64) uint32_t state[8 * Lanes];
+    unsigned char tails[Lanes][128];
+    unsigned char const* blocks[Lanes];
+    size_t full[Lanes], total[Lanes];
+
+    for (size_t first = 0; first < count; first += Lanes)
+    {
+        int n = int(std::min<size_t>(Lanes, count - first));
+        size_t longest = 0;
+
+        for (int l = 0; l < Lanes; ++l)
+        {
+            for (int i = 0; i < 8; ++i)
+                state[i * Lanes + l] = start[i];
+            if (l >= n) {
+                full[l] = total[l] = 0;
+                continue;
+            }
+
+            // Tail: leftover bytes, 0x80, zeros and the bit length, in one or two blocks.
+            size_t size = sizes[first + l];
+            size_t rest = size % 64;
+            full[l] = size / 64;
+            total[l] = full[l] + (rest < 56 ? 1 : 2);
+            size_t tail = (total[l] - full[l]) * 64;
+            std::memset(tails[l], 0, tail);
+            if (rest != 0)
+                std::memcpy(tails[l], data[first + l] + full[l] * 64, rest);
+            tails[l][rest] = 0x80;
+            uint64_t bits = (prefix + size) * 8;
+            for (int i = 0; i < 8; ++i)
+                tails[l][tail - 1 - i] = (unsigned char)(bits >> (8 * i));
+            longest = std::max(longest, total[l]);
+        }
+
+        for (size_t j = 0; j < longest; ++j)
+        {
+            unsigned mask = 0;
+            for (int l = 0; l < Lanes; ++l)
+            {
+                if (j < full[l]) {
+                    blocks[l] = data[first + l] + j * 64;
+                } else if (j < total[l]) {
+                    blocks[l] = tails[l] + (j - full[l]) * 64;
+                } else {
+                    blocks[l] = zero_block;
+                    continue;
+                }
+                mask |= 1u << l;
+            }
+            compress(state, blocks, mask);
+        }
+
+        for (int l = 0; l < n; ++l)
+        {
+            unsigned char* out = digests + 32 * (first + l);
+            for (int i = 0; i < 8; ++i)
+            {
+                uint32_t v = state[i * Lanes + l];
+                out[4 * i + 0] = (unsigned char)(v >> 24);
+                out[4 * i + 1] = (unsigned char)(v >> 16);
+                out[4 * i + 2] = (unsigned char)(v >> 8);
+                out[4 * i + 3] = (unsigned char)(v);
+            }
+        }
+    }
+
+    // Tails may hold key material when hashing secrets.
+    void* (*volatile memset_volatile)(void*, int, size_t) = std::memset;
+    memset_volatile(tails, 0, sizeof(tails));
+}
+
+} // anonymous namespace
+
+void hash_x8(unsigned char const* const* data, size_t const* sizes, size_t count,
+             unsigned char* digests)
+{
+    hash_lanes<8>(x8::compress, initial_state, 0, data, sizes, count, digests);
+}
+
+void hash_x16(unsigned char const* const* data, size_t const* sizes, size_t count,
+              unsigned char* digests)
+{
+    hash_lanes<16>(x16::compress, initial_state, 0, data, sizes, count, digests);
+}
+
+void hash_x8_from(uint32_t const* midstate, uint64_t prefix, unsigned char const* const* data,
+                  size_t const* sizes, size_t count, unsigned char* digests)
+{
+    hash_lanes<8>(x8::compress, midstate, prefix, data, sizes, count, digests);
+}
+
+void hash_x16_from(uint32_t const* midstate, uint64_t prefix, unsigned char const* const* data,
+                   size_t const* sizes, size_t count, unsigned char* digests)
+{
+    hash_lanes<16>(x16::compress, midstate, prefix, data, sizes, count, digests);
+}
+
+#else // KRYPTO_HAVE_SHA256_MB
+
+void hash_x8(unsigned char const* const*, size_t const*, size_t, unsigned char*)
+{
+    assert(!"AVX2 is not available on this architecture");
+}
+
+void hash_x16(unsigned char const* const*, size_t const*, size_t, unsigned char*)
+{
+    assert(!"AVX-512 is not available on this architecture");
+}
+
+void hash_x8_from(uint32_t const*, uint64_t, unsigned char const* const*, size_t const*, size_t,
+                  unsigned char*)
+{
+    assert(!"AVX2 is not available on this architecture");
+}
+
+void hash_x16_from(uint32_t const*, uint64_t, unsigned char const* const*, size_t const*, size_t,
+                   unsigned char*)
+{
+    assert(!"AVX-512 is not available on this architecture");
+}
+
+#endif // KRYPTO_HAVE_SHA256_MB
+
+} // sha256_mb namespace
+} // crypto namespace
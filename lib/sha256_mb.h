@@ -0,0 +1,38 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Multi-buffer SHA-256 kernels. Internal to libkrypto, dispatch::supported() tells which ones may run.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crypto {
+namespace sha256_mb {
+
+/// Hash @a count independent messages, eight at a time in AVX2 lanes.
+/// Digest i is written to @a digests + 32 * i.
+void hash_x8(unsigned char const* const* data, size_t const* sizes, size_t count,
+             unsigned char* digests);
+
+/// The same, sixteen at a time in AVX-512 lanes.
+void hash_x16(unsigned char const* const* data, size_t const* sizes, size_t count,
+              unsigned char* digests);
+
+/// Like hash_x8(), but every message continues from @a midstate, the state words
+/// after @a prefix bytes (a multiple of 64) were hashed.
+void hash_x8_from(uint32_t const* midstate, uint64_t prefix, unsigned char const* const* data,
+                  size_t const* sizes, size_t count, unsigned char* digests);
+
+/// Like hash_x16(), continuing from @a midstate.
+void hash_x16_from(uint32_t const* midstate, uint64_t prefix, unsigned char const* const* data,
+                   size_t const* sizes, size_t count, unsigned char* digests);
+
+} // sha256_mb namespace
+} // crypto namespace
@@ -0,0 +1,194 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "krypto/dispatch.h"
+#include "sha_ni.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KRYPTO_HAVE_SHANI 1
+#include <immintrin.h>
+#define SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+
+namespace crypto {
+namespace shani {
+
+namespace {
+
+struct sha256_state
+{
+    uint32_t h[8];
+    uint64_t length;           ///< Bytes hashed so far.
+    unsigned char buffer[64];  ///< Pending partial block.
+};
+
+static_assert(sizeof(sha256_state) <= dispatch::hash_state_size, "hash_state_size too small");
+
+const uint32_t initial_state[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+} // anonymous namespace
+
+#if KRYPTO_HAVE_SHANI
+
+namespace {
+
+alignas(16) const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+} // anonymous namespace
+
+SHANI_TARGET void
+sha256_blocks(uint32_t* state, unsigned char const* data, size_t blocks)
+{
+    const __m128i byteswap = _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull);
+
+    // SHA256RNDS2 wants the state as ABEF and CDGH.
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const*)state), 0xb1);     // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((__m128i const*)(state + 4)), 0x1b); // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xf0);       // CDGH
+
+    // Four rounds with message quad w plus round constants K[4i..4i+3].
+#define ROUNDS(i, w) \
+    m = _mm_add_epi32(w, _mm_load_si128((__m128i const*)(K + 4 * (i)))); \
+    state1 = _mm_sha256rnds2_epu32(state1, state0, m); \
+    state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(m, 0x0e))
+
+    // Next message quad into w0 from the previous four, w0 (oldest) to w3.
+#define SCHEDULE(w0, w1, w2, w3) \
+    w0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), \
+                                            _mm_alignr_epi8(w3, w2, 4)), w3)
+
+    for (; blocks > 0; --blocks, data += 64)
+    {
+        __m128i abef = state0, cdgh = state1, m;
+        __m128i w0 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const*)(data + 0)), byteswap);
+        __m128i w1 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const*)(data + 16)), byteswap);
+        __m128i w2 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const*)(data + 32)), byteswap);
+        __m128i w3 = _mm_shuffle_epi8(_mm_loadu_si128((__m128i const*)(data + 48)), byteswap);
+
+        // Straight-line code, so that the message quads stay in registers.
+        ROUNDS(0, w0);
+        ROUNDS(1, w1);
+        ROUNDS(2, w2);
+        ROUNDS(3, w3);
+        SCHEDULE(w0, w1, w2, w3); ROUNDS(4, w0);
+        SCHEDULE(w1, w2, w3, w0); ROUNDS(5, w1);
+        SCHEDULE(w2, w3, w0, w1); ROUNDS(6, w2);
+        SCHEDULE(w3, w0, w1, w2); ROUNDS(7, w3);
+        SCHEDULE(w0, w1, w2, w3); ROUNDS(8, w0);
+        SCHEDULE(w1, w2, w3, w0); ROUNDS(9, w1);
+        SCHEDULE(w2, w3, w0, w1); ROUNDS(10, w2);
+        SCHEDULE(w3, w0, w1, w2); ROUNDS(11, w3);
+        SCHEDULE(w0, w1, w2, w3); ROUNDS(12, w0);
+        SCHEDULE(w1, w2, w3, w0); ROUNDS(13, w1);
+        SCHEDULE(w2, w3, w0, w1); ROUNDS(14, w2);
+        SCHEDULE(w3, w0, w1, w2); ROUNDS(15, w3);
+
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+#undef SCHEDULE
+#undef ROUNDS
+
+    tmp = _mm_shuffle_epi32(state0, 0x1b);             // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xb1);          // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xf0);       // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);          // HGFE
+    _mm_storeu_si128((__m128i*)state, state0);
+    _mm_storeu_si128((__m128i*)(state + 4), state1);
+}
+
+#else // KRYPTO_HAVE_SHANI
+
+void sha256_blocks(uint32_t*, unsigned char const*, size_t)
+{
+    assert(!"SHA-NI is not available on this architecture");
+}
+
+#endif // KRYPTO_HAVE_SHANI
+
+void sha256_init(void* state)
+{
+    sha256_state* s = (sha256_state*)state;
+    std::copy(initial_state, initial_state + 8, s->h);
+    s->length = 0;
+}
+
+void sha256_update(void* state, unsigned char const* data, size_t size)
+{
+    sha256_state* s = (sha256_state*)state;
+    size_t used = s->length % 64;
+    s->length += size;
+
+    if (used != 0)
+    {
+        size_t n = std::min(size, 64 - used);
+        std::memcpy(s->buffer + used, data, n);
+        data += n;
+        size -= n;
+        if (used + n < 64) {
+            return;
+        }
+        sha256_blocks(s->h, s->buffer, 1);
+    }
+
+    sha256_blocks(s->h, data, size / 64);
+    std::memcpy(s->buffer, data + size / 64 * 64, size % 64);
+}
+
+void sha256_final(void* state, unsigned char* digest)
+{
+    sha256_state* s = (sha256_state*)state;
+    size_t used = s->length % 64;
+    uint64_t bits = s->length * 8;
+
+    s->buffer[used++] = 0x80;
+    if (used > 56) {
+        std::memset(s->buffer + used, 0, 64 - used);
+        sha256_blocks(s->h, s->buffer, 1);
+        used = 0;
+    }
+    std::memset(s->buffer + used, 0, 56 - used);
+    for (int i = 0; i < 8; ++i) {
+        s->buffer[63 - i] = (unsigned char)(bits >> (8 * i));
+    }
+    sha256_blocks(s->h, s->buffer, 1);
+
+    for (int i = 0; i < 8; ++i) {
+        digest[4 * i + 0] = (unsigned char)(s->h[i] >> 24);
+        digest[4 * i + 1] = (unsigned char)(s->h[i] >> 16);
+        digest[4 * i + 2] = (unsigned char)(s->h[i] >> 8);
+        digest[4 * i + 3] = (unsigned char)(s->h[i]);
+    }
+}
+
+void sha256_hash(unsigned char const* data, size_t size, unsigned char* digest)
+{
+    sha256_state s;
+    sha256_init(&s);
+    sha256_update(&s, data, size);
+    sha256_final(&s, digest);
+}
+
+} // shani namespace
+} // crypto namespace
@@ -0,0 +1,29 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// SHA-NI kernels. Internal to libkrypto, dispatch::supported() tells which ones may run.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace crypto {
+namespace shani {
+
+/// Run the SHA-256 compression function over @a blocks 64-byte blocks of @a data.
+void sha256_blocks(uint32_t* state, unsigned char const* data, size_t blocks);
+
+/// Hash kernel entry points (see dispatch::hash_kernel) built on sha256_blocks().
+void sha256_init(void* state);
+void sha256_update(void* state, unsigned char const* data, size_t size);
+void sha256_final(void* state, unsigned char* digest);
+void sha256_hash(unsigned char const* data, size_t size, unsigned char* digest);
+
+} // shani namespace
+} // crypto namespace
@@ -0,0 +1,182 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include "krypto/sign_engine.h"
+
+namespace crypto {
+
+namespace {
+
+/// The engine whose worker runs on this thread, if any, and that worker's queue.
+thread_local sign_engine const* current_engine = nullptr;
+thread_local size_t current_queue = 0;
+
+} // anonymous namespace
+
+sign_engine::sign_engine(size_t threads)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        queues_.emplace_back(new queue);
+    }
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back([this, i] { worker(i); });
+    }
+}
+
+sign_engine::~sign_engine()
+{
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+std::future<byte_array>
+sign_engine::sign(std::shared_ptr<sign_key const> key, byte_array digest)
+{
+    auto task = std::make_shared<std::packaged_task<byte_array()>>(
+        [key, digest] { return key->sign(digest); });
+    std::future<byte_array> result = task->get_future();
+    submit([task] { (*task)(); });
+    return result;
+}
+
+std::future<bool>
+sign_engine::verify(std::shared_ptr<sign_key const> key, byte_array digest, byte_array signature)
+{
+    auto task = std::make_shared<std::packaged_task<bool()>>(
+        [key, digest, signature] { return key->verify(digest, signature); });
+    std::future<bool> result = task->get_future();
+    submit([task] { (*task)(); });
+    return result;
+}
+
+void
+sign_engine::async_sign(std::shared_ptr<sign_key const> key, byte_array digest,
+                        boost::asio::io_service& io, sign_handler handler)
+{
+    submit([key, digest, &io, handler] {
+        byte_array signature;
+        try {
+            signature = key->sign(digest);
+        } catch (std::exception const&) {
+            signature = byte_array();
+        }
+        io.post([handler, signature] { handler(signature); });
+    });
+}
+
+void
+sign_engine::async_verify(std::shared_ptr<sign_key const> key, byte_array digest,
+                          byte_array signature, boost::asio::io_service& io, verify_handler handler)
+{
+    submit([key, digest, signature, &io, handler] {
+        bool valid = false;
+        try {
+            valid = key->verify(digest, signature);
+        } catch (std::exception const&) {
+            valid = false;
+        }
+        io.post([handler, valid] { handler(valid); });
+    });
+}
+
+sign_engine::clock::duration
+sign_engine::average_latency() const
+{
+    uint64_t n = completed();
+    if (n == 0) {
+        return clock::duration::zero();
+    }
+    return clock::duration(clock::rep(total_latency_.load(std::memory_order_relaxed) / n));
+}
+
+void
+sign_engine::submit(std::function<void()> fn)
+{
+    // A worker keeps the jobs it submits, like continuations; idle workers steal them.
+    size_t index = current_engine == this
+        ? current_queue
+        : next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+    queue& q = *queues_[index];
+    {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.jobs.push_back(job{std::move(fn), clock::now()});
+        pending_.fetch_add(1);
+    }
+    // Taking the idle lock orders this with a worker checking pending_ before it sleeps.
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+    }
+    wake_.notify_one();
+}
+
+// Own queue from the front, then steal from the back of the others.
+bool
+sign_engine::take(size_t self, job& out)
+{
+    for (size_t k = 0; k < queues_.size(); ++k)
+    {
+        queue& q = *queues_[(self + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.jobs.empty()) {
+            continue;
+        }
+        if (k == 0) {
+            out = std::move(q.jobs.front());
+            q.jobs.pop_front();
+        } else {
+            out = std::move(q.jobs.back());
+            q.jobs.pop_back();
+            stolen_.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void
+sign_engine::worker(size_t self)
+{
+    current_engine = this;
+    current_queue = self;
+    for (;;)
+    {
+        job j;
+        if (take(self, j))
+        {
+            j.run();
+
+            clock::rep latency = (clock::now() - j.queued).count();
+            total_latency_.fetch_add(uint64_t(latency), std::memory_order_relaxed);
+            clock::rep seen = max_latency_.load(std::memory_order_relaxed);
+            while (latency > seen
+                   and !max_latency_.compare_exchange_weak(seen, latency, std::memory_order_relaxed))
+            {}
+            completed_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idle_mutex_);
+        wake_.wait(lock, [this] { return pending_.load() > 0 or stopping_; });
+        if (stopping_ and pending_.load() == 0) {
+            return;
+        }
+    }
+}
+
+} // crypto namespace
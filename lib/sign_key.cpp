@@ -6,7 +6,9 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
+#include <cassert>
 #include "krypto/sign_key.h"
+#include "krypto/sha256_hash.h"
 
 namespace crypto {
 
@@ -17,4 +19,53 @@ sign_key::sign_key()
 sign_key::~sign_key()
 {}
 
+byte_array const&
+sign_key::public_key() const
+{
+    assert(type() != invalid);
+    std::call_once(public_key_once_, [this] { public_key_ = encode_public_key(); });
+    return public_key_;
+}
+
+byte_array const&
+sign_key::id() const
+{
+    std::call_once(id_once_, [this] {
+        id_ = sha256::to_byte_array(sha256::hash(public_key()));
+        id_.resize(id_size());
+    });
+    return id_;
+}
+
+std::vector<byte_array>
+sign_key::ids(std::vector<sign_key const*> const& keys)
+{
+    std::vector<unsigned char const*> data;
+    std::vector<size_t> sizes;
+    data.reserve(keys.size());
+    sizes.reserve(keys.size());
+    for (sign_key const* key : keys)
+    {
+        byte_array const& public_key = key->public_key();
+        data.push_back((unsigned char const*)public_key.const_data());
+        sizes.push_back(public_key.size());
+    }
+
+    std::vector<sha256::digest> digests(keys.size());
+    sha256::hash_batch(data.data(), sizes.data(), keys.size(), digests.data());
+
+    std::vector<byte_array> result;
+    result.reserve(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        sign_key const* key = keys[i];
+        std::call_once(key->id_once_, [key, &digests, i] {
+            key->id_ = sha256::to_byte_array(digests[i]);
+            key->id_.resize(key->id_size());
+        });
+        result.push_back(key->id_);
+    }
+    return result;
+}
+
 } // crypto namespace
@@ -6,6 +6,7 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
 //
+#include <algorithm>
 #include <boost/asio/buffer.hpp>
 #include <crypto_stream_xsalsa20.h> // nacl
 #include "krypto/stream_cipher_xsalsa20.h"
@@ -15,20 +16,50 @@ namespace crypto {
 
 xsalsa20::xsalsa20(byte_array const& key)
 {
-    key_ = key.as_string();
-    assert(key_.length() == crypto_stream_xsalsa20_KEYBYTES);
+    assert(key.size() == crypto_stream_xsalsa20_KEYBYTES);
+    std::copy(key.begin(), key.end(), key_);
 }
 
 xsalsa20::~xsalsa20()
 {
-    auto wrap = boost::asio::buffer((void*)&key_, crypto_stream_xsalsa20_KEYBYTES);
-    crypto::cleanse(wrap); // Do not leave keys lying around.
+    crypto::cleanse(key_); // Do not leave keys lying around.
 }
 
 byte_array xsalsa20::encrypt(byte_array const& in, std::string iv)
 {
     assert(iv.length() == crypto_stream_xsalsa20_NONCEBYTES);
-    return crypto_stream_xsalsa20_xor(in.as_string(), iv, key_);
+    byte_array out;
+    out.resize(in.size());
+    encrypt((unsigned char const*)in.const_data(), (unsigned char*)out.data(), in.size(),
+        (unsigned char const*)iv.data());
+    return out;
+}
+
+void xsalsa20::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv) const
+{
+    assert(in == out or in + size <= out or out + size <= in);
+    crypto_stream_xsalsa20_xor(out, in, size, iv, key_);
+}
+
+void xsalsa20::encrypt(unsigned char const* in, unsigned char* out, size_t size,
+    unsigned char const* iv, uint64_t ic) const
+{
+    assert(in == out or in + size <= out or out + size <= in);
+    crypto_stream_xsalsa20_xor_ic(out, in, size, iv, ic, key_);
+}
+
+size_t xsalsa20::encrypt(packet* packets, size_t count) const
+{
+    size_t done = 0;
+    for (size_t i = 0; i < count; ++i) {
+        packets[i].ok = internal::valid(packets[i]);
+        if (packets[i].ok) {
+            encrypt(packets[i].in, packets[i].out, packets[i].size, packets[i].iv);
+            ++done;
+        }
+    }
+    return done;
 }
 
 } // crypto namespace
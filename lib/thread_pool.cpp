@@ -0,0 +1,116 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include "krypto/thread_pool.h"
+
+namespace crypto {
+
+namespace {
+
+/// The pool whose job this thread is running a piece of, if any.
+thread_local thread_pool const* running_pool = nullptr;
+
+} // anonymous namespace
+
+thread_pool::thread_pool(size_t threads)
+{
+    if (threads == 0) {
+        size_t hw = std::thread::hardware_concurrency();
+        threads = hw > 1 ? hw - 1 : 0;
+    }
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back([this] { worker(); });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& t : workers_) {
+        t.join();
+    }
+}
+
+thread_pool& thread_pool::shared()
+{
+    static thread_pool pool;
+    return pool;
+}
+
+// Take and run pieces of the current job until none are left.
+// Returns true if this call finished the last piece.
+bool thread_pool::run_pieces(std::unique_lock<std::mutex>& lock)
+{
+    bool last = false;
+    while (job_ and next_ < count_)
+    {
+        size_t piece = next_++;
+        std::function<void(size_t)> const& fn = *job_;
+        lock.unlock();
+        thread_pool const* outer = running_pool;
+        running_pool = this;
+        fn(piece);
+        running_pool = outer;
+        lock.lock();
+        last = (++finished_ == count_);
+    }
+    return last;
+}
+
+void thread_pool::worker()
+{
+    uint64_t seen = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        wake_.wait(lock, [&] { return stopping_ or generation_ != seen; });
+        if (stopping_) {
+            return;
+        }
+        seen = generation_;
+        if (run_pieces(lock)) {
+            done_.notify_all();
+        }
+    }
+}
+
+void thread_pool::parallel_for(size_t count, std::function<void(size_t)> const& fn)
+{
+    if (count == 0) {
+        return;
+    }
+    // A piece that calls back into its own pool would wait on job_mutex_ forever,
+    // and the other threads are busy with its siblings anyway.
+    if (count == 1 or workers_.empty() or running_pool == this)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    std::lock_guard<std::mutex> serial(job_mutex_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    job_ = &fn;
+    count_ = count;
+    next_ = 0;
+    finished_ = 0;
+    ++generation_;
+    wake_.notify_all();
+
+    run_pieces(lock);
+    done_.wait(lock, [&] { return finished_ == count_; });
+    job_ = nullptr;
+}
+
+} // crypto namespace
@@ -0,0 +1,132 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <algorithm>
+#include <cassert>
+#include "krypto/tree_hash.h"
+
+namespace crypto {
+namespace tree_hash {
+
+namespace {
+
+// Domain separation between leaves and interior nodes (as in RFC 6962).
+const unsigned char leaf_prefix = 0x00;
+const unsigned char node_prefix = 0x01;
+
+} // anonymous namespace
+
+digest leaf(unsigned char const* chunk, size_t size)
+{
+    sha256::context ctx;
+    ctx.update(&leaf_prefix, 1);
+    ctx.update(chunk, size);
+    return ctx.finalize();
+}
+
+digest node(digest const& left, digest const& right)
+{
+    sha256::context ctx;
+    ctx.update(&node_prefix, 1);
+    ctx.update(left.data(), left.size());
+    ctx.update(right.data(), right.size());
+    return ctx.finalize();
+}
+
+std::vector<digest> leaves(unsigned char const* data, size_t size, size_t chunk_size,
+                           thread_pool& pool)
+{
+    assert(chunk_size > 0);
+    std::vector<digest> out(chunk_count(size, chunk_size));
+
+    auto hash_chunk = [&](size_t i) {
+        size_t offset = i * chunk_size;
+        out[i] = leaf(data + offset, std::min(chunk_size, size - offset));
+    };
+
+    if (out.size() < 2) {
+        hash_chunk(0);
+    } else {
+        pool.parallel_for(out.size(), hash_chunk);
+    }
+    return out;
+}
+
+namespace {
+
+/// Replace a tree level with the one above it: neighbours are paired up,
+/// and an odd node out at the end is carried up unchanged.
+void next_level(std::vector<digest>& level)
+{
+    size_t n = level.size();
+    for (size_t i = 0; i < n / 2; ++i) {
+        level[i] = node(level[2 * i], level[2 * i + 1]);
+    }
+    if (n % 2) {
+        level[n / 2] = level[n - 1];
+    }
+    level.resize((n + 1) / 2);
+}
+
+} // anonymous namespace
+
+digest root(std::vector<digest> const& leaves)
+{
+    assert(!leaves.empty());
+    std::vector<digest> level(leaves);
+    while (level.size() > 1) {
+        next_level(level);
+    }
+    return level[0];
+}
+
+std::vector<digest> proof(std::vector<digest> const& leaves, size_t index)
+{
+    assert(index < leaves.size());
+    std::vector<digest> path;
+    std::vector<digest> level(leaves);
+    while (level.size() > 1)
+    {
+        size_t n = level.size();
+        if (index % 2) {
+            path.push_back(level[index - 1]);
+        } else if (index + 1 < n) {
+            path.push_back(level[index + 1]);
+        }
+
+        next_level(level);
+        index /= 2;
+    }
+    return path;
+}
+
+bool verify(digest const& leaf_digest, size_t index, size_t count,
+            std::vector<digest> const& proof, digest const& root_digest)
+{
+    if (index >= count) {
+        return false;
+    }
+
+    digest h = leaf_digest;
+    size_t used = 0;
+    for (size_t n = count; n > 1; n = (n + 1) / 2, index /= 2)
+    {
+        if (index % 2 == 0 and index + 1 == n) {
+            continue; // carried up without a sibling
+        }
+        if (used == proof.size()) {
+            return false;
+        }
+        h = (index % 2) ? node(proof[used], h) : node(h, proof[used]);
+        ++used;
+    }
+    return used == proof.size() and h == root_digest;
+}
+
+} // tree_hash namespace
+} // crypto namespace
@@ -0,0 +1,112 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#include <cassert>
+#include "krypto/verify_cache.h"
+
+namespace crypto {
+
+namespace {
+
+/// Add a length-prefixed field, so that field boundaries cannot shift.
+void add_field(sha256::context& ctx, byte_array const& field)
+{
+    unsigned char length[8];
+    uint64_t n = field.size();
+    for (int i = 7; i >= 0; --i, n >>= 8) {
+        length[i] = (unsigned char)n;
+    }
+    ctx.update(length, sizeof(length));
+    ctx.update(field);
+}
+
+} // anonymous namespace
+
+verify_cache::verify_cache(size_t capacity, clock::duration ttl)
+    : capacity_(capacity)
+    , ttl_(ttl)
+{
+    assert(capacity_ > 0);
+}
+
+bool verify_cache::verify(sign_key const& key, byte_array const& digest, byte_array const& signature)
+{
+    sha256::context ctx;
+    add_field(ctx, key.id());
+    add_field(ctx, digest);
+    add_field(ctx, signature);
+    entry_key k = ctx.finalize();
+
+    if (lookup(k))
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    // Verify without holding the lock; concurrent misses on one entry simply insert it twice.
+    if (!key.verify(digest, signature)) {
+        return false;
+    }
+    insert(k);
+    return true;
+}
+
+bool verify_cache::lookup(entry_key const& k)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(k);
+    if (it == index_.end()) {
+        return false;
+    }
+    if (it->second->expires <= clock::now())
+    {
+        lru_.erase(it->second);
+        index_.erase(it);
+        return false;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return true;
+}
+
+void verify_cache::insert(entry_key const& k)
+{
+    clock::time_point expires = clock::now() + ttl_;
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = index_.find(k);
+    if (it != index_.end())
+    {
+        it->second->expires = expires;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+
+    if (index_.size() >= capacity_)
+    {
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+    lru_.push_front(entry{k, expires});
+    index_.emplace(k, lru_.begin());
+}
+
+size_t verify_cache::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+void verify_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.clear();
+    lru_.clear();
+}
+
+} // crypto namespace
@@ -11,6 +11,7 @@
 
 #include "krypto/krypto.h"
 #include "krypto/aes_128_ctr.h"
+#include "krypto/packet.h"
 
 BOOST_AUTO_TEST_CASE(encode_then_decode)
 {
@@ -46,3 +47,96 @@ BOOST_AUTO_TEST_CASE(encode_then_decode)
 
     crypto::cleanse(vec);                                      // clear sensitive data
 }
+
+BOOST_AUTO_TEST_CASE(encrypt_in_place)
+{
+    crypto::block key;
+    crypto::block iv;
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+
+    crypto::aes_128_ctr aes(byte_array((char const*)key.data(), key.size()));
+
+    byte_array text{"Mary had a little lamb, its fleece was white as snow"};
+    byte_array encrypted = aes.encrypt(text, iv);
+
+    std::vector<unsigned char> buffer(text.begin(), text.end());
+    aes.encrypt_in_place(buffer, iv);
+    BOOST_CHECK(std::equal(buffer.begin(), buffer.end(), (unsigned char const*)encrypted.const_data()));
+
+    std::vector<unsigned char> decrypted(buffer.size());
+    aes.decrypt(buffer, decrypted, iv);
+    BOOST_CHECK(std::equal(text.begin(), text.end(), decrypted.begin()));
+
+    crypto::cleanse(key);
+}
+
+BOOST_AUTO_TEST_CASE(encrypt_batch)
+{
+    std::vector<char> key(16);
+    crypto::fill_random(key);
+    crypto::aes_128_ctr aes(key);
+
+    const size_t count = 40;
+    std::vector<crypto::block> ivs(count);
+    std::vector<std::vector<unsigned char>> texts(count), outs(count);
+    std::vector<crypto::packet> batch(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        crypto::fill_random(ivs[i]);
+        if (i % 5 == 0) {
+            ivs[i][12] = ivs[i][13] = ivs[i][14] = 0xff; // counter wraps inside the packet
+        }
+        texts[i].resize(i * 7 % 90);
+        crypto::fill_random(texts[i]);
+        outs[i].resize(texts[i].size());
+        batch[i] = crypto::packet{ivs[i].data(), texts[i].data(), outs[i].data(), texts[i].size(), false};
+    }
+    batch[3].iv = nullptr; // invalid entries are skipped
+
+    BOOST_CHECK(aes.encrypt(batch.data(), batch.size()) == count - 1);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        BOOST_CHECK(batch[i].ok == (i != 3));
+        if (i == 3) {
+            continue;
+        }
+        std::vector<unsigned char> expected(texts[i].size());
+        aes.encrypt(texts[i], expected, ivs[i]);
+        BOOST_CHECK(outs[i] == expected);
+    }
+
+    crypto::cleanse(key);
+}
+
+// The cached key schedule gives the same stream as expanding the key on every call.
+// Timings are in benchmarks/bench_aes_128_ctr.cpp.
+BOOST_AUTO_TEST_CASE(cached_schedule_matches_per_call)
+{
+    using namespace crypto::dispatch;
+
+    // Both sides use libsodium's bitsliced code, only the key expansion differs.
+    impl original = selected(primitive::aes_128_ctr);
+    force(primitive::aes_128_ctr, impl::portable);
+
+    std::vector<unsigned char> key(16);
+    crypto::fill_random(key);
+    crypto::aes_128_ctr aes(byte_array((char const*)key.data(), key.size()));
+
+    std::vector<unsigned char> packet(1024), out(packet.size()), cached_out(packet.size());
+    crypto::fill_random(packet);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        crypto::block iv;
+        crypto::fill_random(iv);
+        crypto_stream_aes128ctr_xor(out.data(), packet.data(), packet.size(), iv.data(), key.data());
+        aes.encrypt(packet.data(), cached_out.data(), packet.size(), iv.data());
+        BOOST_CHECK(out == cached_out);
+    }
+
+    force(primitive::aes_128_ctr, original);
+    crypto::cleanse(key);
+}
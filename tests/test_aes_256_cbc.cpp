@@ -0,0 +1,211 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_aes_256_cbc
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <openssl/evp.h>
+
+#include "krypto/krypto.h"
+#include "krypto/aes_256_cbc.h"
+
+using crypto::aes_256_cbc;
+using namespace crypto::dispatch;
+
+namespace {
+
+byte_array from_hex(std::string const& hex)
+{
+    byte_array out;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        out.as_vector().push_back(char(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+// Reference AES-256-CBC without padding straight from OpenSSL EVP.
+std::vector<unsigned char> reference(byte_array const& key, crypto::block const& iv,
+                                     std::vector<unsigned char> const& in)
+{
+    std::vector<unsigned char> out(in.size());
+    int len = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_aes_256_cbc(), nullptr, (unsigned char const*)key.const_data(), iv.data());
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_EncryptUpdate(ctx, out.data(), &len, in.data(), in.size());
+    EVP_CIPHER_CTX_free(ctx);
+    return out;
+}
+
+byte_array random_key()
+{
+    byte_array key;
+    key.resize(aes_256_cbc::key_size);
+    crypto::fill_random(key.as_vector());
+    return key;
+}
+
+} // anonymous namespace
+
+// NIST SP 800-38A, F.2.5 and F.2.6 CBC-AES256.
+BOOST_AUTO_TEST_CASE(known_answer)
+{
+    byte_array key = from_hex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+    byte_array iv = from_hex("000102030405060708090a0b0c0d0e0f");
+    byte_array plain = from_hex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                                "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    byte_array cipher = from_hex("f58c4c04d6e5f1ba779eabfb5f7bfbd69cfc4e967edb808d679f777bc6702c7d"
+                                 "39f23369a9d9bacfa530e26304231461b2eb05e2c39be9fcda6c19078c6a9d1b");
+
+    impl original = selected(primitive::aes_256_cbc);
+    for (impl i : { impl::portable, impl::aesni })
+    {
+        if (!force(primitive::aes_256_cbc, i)) {
+            continue;
+        }
+        BOOST_TEST_MESSAGE(name(i));
+        std::vector<unsigned char> out(plain.size());
+        aes_256_cbc(aes_256_cbc::type::encrypt, key).encrypt(
+            (unsigned char const*)plain.const_data(), out.data(), out.size(),
+            (unsigned char const*)iv.const_data());
+        BOOST_CHECK(std::equal(out.begin(), out.end(), (unsigned char const*)cipher.const_data()));
+
+        aes_256_cbc(aes_256_cbc::type::decrypt, key).decrypt(out.data(), out.data(), out.size(),
+            (unsigned char const*)iv.const_data());
+        BOOST_CHECK(std::equal(out.begin(), out.end(), (unsigned char const*)plain.const_data()));
+    }
+    force(primitive::aes_256_cbc, original);
+}
+
+BOOST_AUTO_TEST_CASE(encode_then_decode)
+{
+    byte_array key = random_key();
+    aes_256_cbc enc(aes_256_cbc::type::encrypt, key);
+    aes_256_cbc dec(aes_256_cbc::type::decrypt, key);
+
+    for (size_t size : { 1, 15, 16, 17, 1000, 4096 })
+    {
+        byte_array msg;
+        msg.resize(size);
+        crypto::fill_random(msg.as_vector());
+
+        byte_array sealed = enc.encrypt(msg);
+        BOOST_CHECK_EQUAL(sealed.size(), 16 + (size + 15) / 16 * 16);
+
+        byte_array opened = dec.decrypt(sealed);
+        BOOST_REQUIRE_EQUAL(opened.size(), (size + 15) / 16 * 16);
+        BOOST_CHECK(std::equal(msg.const_data(), msg.const_data() + size, opened.const_data()));
+        BOOST_CHECK(std::all_of(opened.const_data() + size, opened.const_data() + opened.size(),
+                                [](char c) { return c == 0; }));
+    }
+    BOOST_CHECK_EQUAL(dec.decrypt(byte_array()).size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(matches_openssl)
+{
+    byte_array key = random_key();
+    crypto::block iv;
+    crypto::fill_random(iv);
+    std::vector<unsigned char> text(16 * 101), out(text.size());
+    crypto::fill_random(text);
+
+    impl original = selected(primitive::aes_256_cbc);
+    for (impl i : { impl::portable, impl::aesni })
+    {
+        if (!force(primitive::aes_256_cbc, i)) {
+            continue;
+        }
+        aes_256_cbc(aes_256_cbc::type::encrypt, key).encrypt(text.data(), out.data(), out.size(), iv.data());
+        BOOST_CHECK(out == reference(key, iv, text));
+    }
+    force(primitive::aes_256_cbc, original);
+}
+
+BOOST_AUTO_TEST_CASE(encrypt_batch)
+{
+    byte_array key = random_key();
+    aes_256_cbc enc(aes_256_cbc::type::encrypt, key);
+    aes_256_cbc dec(aes_256_cbc::type::decrypt, key);
+
+    // Messages of different lengths retire from the lanes at different times.
+    const size_t count = 21;
+    std::vector<std::vector<unsigned char>> in(count), out(count), expected(count);
+    std::vector<crypto::block> ivs(count);
+    std::vector<crypto::packet> packets(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t size = (i == 5) ? 33 : 16 * ((i * 7) % 13);
+        in[i].resize(size);
+        out[i].resize(size);
+        expected[i].resize(size);
+        crypto::fill_random(in[i]);
+        crypto::fill_random(ivs[i]);
+        if (size % 16 == 0) {
+            enc.encrypt(in[i].data(), expected[i].data(), size, ivs[i].data());
+        }
+        packets[i] = crypto::packet{ivs[i].data(), in[i].data(), out[i].data(), size, false};
+    }
+
+    BOOST_CHECK_EQUAL(enc.encrypt(packets.data(), count), count - 1);
+    BOOST_CHECK(!packets[5].ok);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i != 5) {
+            BOOST_CHECK(out[i] == expected[i]);
+            packets[i].in = out[i].data(); // decrypt in place
+        }
+    }
+
+    BOOST_CHECK_EQUAL(dec.decrypt(packets.data(), count), count - 1);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i != 5) {
+            BOOST_CHECK(out[i] == in[i]);
+        }
+    }
+}
+
+// Concurrent callers of one portable instance run on separate OpenSSL contexts.
+BOOST_AUTO_TEST_CASE(portable_concurrent_callers)
+{
+    impl original = selected(primitive::aes_256_cbc);
+    BOOST_REQUIRE(force(primitive::aes_256_cbc, impl::portable));
+
+    byte_array key = random_key();
+    crypto::block iv;
+    crypto::fill_random(iv);
+    std::vector<unsigned char> text(16 * 63);
+    crypto::fill_random(text);
+    std::vector<unsigned char> expected = reference(key, iv, text);
+    aes_256_cbc enc(aes_256_cbc::type::encrypt, key);
+    aes_256_cbc dec(aes_256_cbc::type::decrypt, key);
+
+    const int threads = 4;
+    std::vector<int> mismatches(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            std::vector<unsigned char> mine(text.size());
+            for (int round = 0; round < 200; ++round)
+            {
+                enc.encrypt(text.data(), mine.data(), mine.size(), iv.data());
+                mismatches[t] += mine != expected;
+                dec.decrypt(mine.data(), mine.data(), mine.size(), iv.data());
+                mismatches[t] += mine != text;
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    for (int m : mismatches) {
+        BOOST_CHECK(m == 0);
+    }
+    force(primitive::aes_256_cbc, original);
+}
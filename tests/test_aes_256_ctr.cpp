@@ -0,0 +1,166 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_aes_256_ctr
+#include <boost/test/unit_test.hpp>
+#include <thread>
+#include <openssl/evp.h>
+
+#include "krypto/krypto.h"
+#include "krypto/aes_256_ctr.h"
+#include "krypto/dispatch.h"
+
+namespace {
+
+byte_array from_hex(std::string const& hex)
+{
+    byte_array out;
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        out.as_vector().push_back(char(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+// Reference AES-256-CTR straight from OpenSSL EVP.
+std::vector<unsigned char> reference(std::vector<char> const& key, crypto::block const& iv,
+                                     std::vector<unsigned char> const& in)
+{
+    std::vector<unsigned char> out(in.size());
+    int len = 0;
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), nullptr, (unsigned char const*)key.data(), iv.data());
+    EVP_EncryptUpdate(ctx, out.data(), &len, in.data(), in.size());
+    EVP_CIPHER_CTX_free(ctx);
+    return out;
+}
+
+} // anonymous namespace
+
+// NIST SP 800-38A, F.5.5 CTR-AES256.Encrypt
+BOOST_AUTO_TEST_CASE(known_answer)
+{
+    crypto::aes_256_ctr aes(from_hex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"));
+    byte_array iv = from_hex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+    byte_array text = from_hex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+                               "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    byte_array expected = from_hex("601ec313775789a5b7a7f504bbf3d228f443e3ca4d62b59aca84e990cacaf5c5"
+                                   "2b0930daa23de94ce87017ba2d84988ddfc9c58db67aada613c2dd08457941a6");
+
+    BOOST_CHECK(aes.encrypt(text, iv.as_string()) == expected);
+    BOOST_CHECK(aes.decrypt(expected, iv.as_string()) == text);
+}
+
+BOOST_AUTO_TEST_CASE(matches_openssl)
+{
+    using namespace crypto::dispatch;
+    impl original = selected(primitive::aes_256_ctr);
+    std::vector<char> key(32);
+    crypto::fill_random(key);
+
+    for (impl i : { impl::portable, impl::aesni, impl::vaes })
+    {
+        if (!force(primitive::aes_256_ctr, i)) {
+            continue;
+        }
+        BOOST_TEST_MESSAGE(name(i));
+        crypto::aes_256_ctr aes(key);
+
+        for (size_t size : {0, 1, 15, 16, 17, 127, 128, 255, 256, 257, 1400, 4099})
+        {
+            crypto::block iv;
+            crypto::fill_random(iv);
+            std::fill(iv.begin() + 8, iv.end(), 0xff); // carry out of the low 64 bits
+
+            std::vector<unsigned char> text(size), out(size);
+            crypto::fill_random(text);
+            aes.encrypt(text, out, iv);
+            BOOST_CHECK(out == reference(key, iv, text));
+
+            aes.decrypt_in_place(out, iv);
+            BOOST_CHECK(out == text);
+        }
+    }
+
+    force(primitive::aes_256_ctr, original);
+    crypto::cleanse(key);
+}
+
+// The portable cipher keeps an OpenSSL context; copies and concurrent callers get their own.
+BOOST_AUTO_TEST_CASE(portable_copies_and_threads)
+{
+    using namespace crypto::dispatch;
+    impl original = selected(primitive::aes_256_ctr);
+    BOOST_REQUIRE(force(primitive::aes_256_ctr, impl::portable));
+
+    std::vector<char> key(32);
+    crypto::fill_random(key);
+    crypto::block iv;
+    crypto::fill_random(iv);
+    std::vector<unsigned char> text(1000 + 7);
+    crypto::fill_random(text);
+    std::vector<unsigned char> expected = reference(key, iv, text);
+
+    crypto::aes_256_ctr aes(key);
+    crypto::aes_256_ctr copy(aes);
+    std::vector<unsigned char> out(text.size());
+    copy.encrypt(text, out, iv);
+    BOOST_CHECK(out == expected);
+
+    const int threads = 4;
+    std::vector<int> mismatches(threads);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t] {
+            std::vector<unsigned char> mine(text.size());
+            for (int round = 0; round < 200; ++round)
+            {
+                aes.encrypt(text, mine, iv);
+                mismatches[t] += mine != expected;
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    for (int m : mismatches) {
+        BOOST_CHECK(m == 0);
+    }
+
+    force(primitive::aes_256_ctr, original);
+    crypto::cleanse(key);
+}
+
+BOOST_AUTO_TEST_CASE(encrypt_batch)
+{
+    std::vector<char> key(32);
+    crypto::fill_random(key);
+    crypto::aes_256_ctr aes(key);
+
+    const size_t count = 33;
+    std::vector<crypto::block> ivs(count);
+    std::vector<std::vector<unsigned char>> texts(count), outs(count);
+    std::vector<crypto::packet> batch(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        crypto::fill_random(ivs[i]);
+        texts[i].resize(i * 13 % 100);
+        crypto::fill_random(texts[i]);
+        outs[i] = texts[i];
+        batch[i] = crypto::packet{ivs[i].data(), outs[i].data(), outs[i].data(), outs[i].size(), false};
+    }
+
+    BOOST_CHECK(aes.encrypt(batch.data(), batch.size()) == count);
+    for (size_t i = 0; i < count; ++i) {
+        BOOST_CHECK(batch[i].ok);
+        BOOST_CHECK(outs[i] == reference(key, ivs[i], texts[i]));
+    }
+
+    crypto::cleanse(key);
+}
@@ -0,0 +1,65 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_cipher_stream
+#include <boost/test/unit_test.hpp>
+
+#include "krypto/krypto.h"
+#include "krypto/cipher_stream.h"
+#include "krypto/aes_128_ctr.h"
+#include "krypto/stream_cipher_xsalsa20.h"
+
+template <typename Cipher>
+void check_chunked_and_seek()
+{
+    std::vector<char> key(Cipher::key_size);
+    std::vector<unsigned char> iv(Cipher::iv_size);
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+
+    std::vector<unsigned char> text(5000);
+    crypto::fill_random(text);
+
+    // Reference: whole message in one call.
+    Cipher cipher(key);
+    std::vector<unsigned char> whole(text.size());
+    cipher.encrypt(text, whole, iv);
+
+    // Odd-sized chunks must produce the same ciphertext.
+    crypto::cipher_stream<Cipher> stream(key, iv);
+    std::vector<unsigned char> chunked(text.size());
+    size_t pos = 0, chunk = 1;
+    while (pos < text.size())
+    {
+        size_t n = std::min(chunk, text.size() - pos);
+        stream.encrypt(text.data() + pos, chunked.data() + pos, n);
+        pos += n;
+        chunk = chunk * 3 + 7;
+    }
+    BOOST_CHECK(stream.offset() == text.size());
+    BOOST_CHECK(chunked == whole);
+
+    // Decrypt an unaligned range after seeking.
+    size_t from = 1234, count = 777;
+    std::vector<unsigned char> part(count);
+    stream.seek(from);
+    stream.decrypt(whole.data() + from, part.data(), count);
+    BOOST_CHECK(std::equal(part.begin(), part.end(), text.begin() + from));
+
+    crypto::cleanse(key);
+}
+
+BOOST_AUTO_TEST_CASE(aes_128_ctr_stream)
+{
+    check_chunked_and_seek<crypto::aes_128_ctr>();
+}
+
+BOOST_AUTO_TEST_CASE(xsalsa20_stream)
+{
+    check_chunked_and_seek<crypto::xsalsa20>();
+}
@@ -2,11 +2,32 @@
 /// http://opensource.org/licenses/BSD-2-Clause
 #define BOOST_TEST_MODULE Test_krypto_primitives
 #include <boost/test/unit_test.hpp>
+#include <algorithm>
 
 #include "krypto/krypto.h"
+#include "krypto/cipher.h"
+#include "krypto/dispatch.h"
+#include "krypto/hash.h"
+#include "krypto/hmac.h"
 #include "krypto/sha256_hash.h"
 #include "krypto/sha512_hash.h"
 
+namespace {
+
+template <typename C>
+std::string to_hex(C const& data)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (unsigned char c : data) {
+        out += digits[c >> 4];
+        out += digits[c & 0xf];
+    }
+    return out;
+}
+
+} // anonymous namespace
+
 BOOST_AUTO_TEST_CASE(random_generation)
 {
     // BOOST_CHECK(crypto::prng_ok());                            // check PRNG state
@@ -19,6 +40,15 @@ BOOST_AUTO_TEST_CASE(random_generation)
     crypto::fill_random(vec);                                  // fill it with random bytes
 }
 
+BOOST_AUTO_TEST_CASE(raw_buffer_length)
+{
+    // Lengths past INT_MAX must come through whole; nothing is read here.
+    static unsigned char byte;
+    size_t const huge = (size_t(1) << 32) + 5;
+    crypto::internal::raw<unsigned char const*> r(boost::asio::buffer(&byte, huge));
+    BOOST_CHECK(r.len == huge);
+}
+
 BOOST_AUTO_TEST_CASE(key_generation)
 {
     crypto::block key;                                         // 128 bit key
@@ -28,38 +58,70 @@ BOOST_AUTO_TEST_CASE(key_generation)
     crypto::cleanse(key);                                      // clear sensitive data
 }
 
-// BOOST_AUTO_TEST_CASE(message_digest)
-// {
-//     crypto::hash md;                                           // the hash object
-//     crypto::hash::value sha;                                   // the hash value
-//     md.update("hello world!");                                 // add data
-//     md.update("see you world!");                               // add more data
-//     md.finalize(sha);                                          // get digest value
-// }
+BOOST_AUTO_TEST_CASE(message_digest)
+{
+    crypto::hash md;                                           // the hash object
+    crypto::hash::value sha;                                   // the hash value
+    md.update("hello world!");                                 // add data
+    md.update("see you world!");                               // add more data
+    md.finalize(sha);                                          // get digest value
+    BOOST_CHECK(sha == crypto::sha256::hash(byte_array("hello world!see you world!")));
+}
 
 BOOST_AUTO_TEST_CASE(message_digest_sha256)
 {
-    std::string hash = crypto::sha256::hash("hello world!");
-    BOOST_CHECK(hash == "12345");
+    crypto::sha256::digest hash = crypto::sha256::hash("hello world!");
+    BOOST_CHECK(to_hex(hash) == "7509e5bda0c762d2bac7f90d758b5b2263fa01ccbc542ab5e3df163be08e6ca9");
+
+    crypto::sha256::context ctx;                               // same digest in pieces
+    ctx.update("hello ");
+    ctx.update(std::string("world!"));
+    BOOST_CHECK(ctx.finalize() == hash);
 }
 
 BOOST_AUTO_TEST_CASE(message_digest_sha512)
 {
-    std::string hash = crypto::sha512::hash("hello world!");
-    BOOST_CHECK(hash == "54321");
+    crypto::sha512::digest hash = crypto::sha512::hash("hello world!");
+    BOOST_CHECK(to_hex(hash) == "db9b1cd3262dee37756a09b9064973589847caa8e53d31a9d142ea27"
+                                "01b1b28abd97838bb9a27068ba305dc8d04a45a1fcf079de54d607666996b3cc54f6b67c");
+
+    using namespace crypto::dispatch;
+    impl original = selected(primitive::sha512);
+    for (impl i : { impl::portable, impl::openssl })
+    {
+        BOOST_REQUIRE(force(primitive::sha512, i));
+        crypto::sha512::context ctx;                           // same digest in pieces
+        ctx.update("hello ");
+        ctx.update(std::string("world!"));
+        BOOST_CHECK(ctx.finalize() == hash);
+
+        std::vector<unsigned char> payload(3 * crypto::sha512::block_size + 5);
+        crypto::fill_random(payload);
+        ctx.update(payload.data(), 100);                       // context is reusable after finalize
+        crypto::sha512::context fork = ctx;
+        ctx.update(payload.data() + 100, payload.size() - 100);
+        BOOST_CHECK(ctx.finalize() == crypto::sha512::hash(payload.data(), payload.size()));
+        BOOST_CHECK(fork.finalize() == crypto::sha512::hash(payload.data(), 100));
+        BOOST_CHECK(ctx.finalize() == crypto::sha512::hash(payload.data(), 0));
+    }
+    force(primitive::sha512, original);
 }
 
-// BOOST_AUTO_TEST_CASE(message_authentication_code)
-// {
-//     crypto::block key;                                         // the hash key
-//     crypto::fill_random(key);                                  // random key will do for now
-//     crypto::hash h(key);                                       // the keyed-hash object
-//     crypto::hash::value mac;                                   // the mac value
-//     h.update("hello world!");                                  // add data
-//     h.update("see you world!");                                // more data
-//     h.finalize(mac);                                           // get the MAC code
-//     crypto::cleanse(key);                                      // clear sensitive data
-// }
+BOOST_AUTO_TEST_CASE(message_authentication_code)
+{
+    crypto::block key;                                         // the hash key
+    crypto::fill_random(key);                                  // random key will do for now
+    crypto::hash h(key);                                       // the keyed-hash object
+    crypto::hash::value mac;                                   // the mac value
+    h.update("hello world!");                                  // add data
+    h.update("see you world!");                                // more data
+    h.finalize(mac);                                           // get the MAC code
+
+    crypto::hmac m(key);                                       // same MAC, truncated
+    crypto::hmac::tag t = m.sign(byte_array("hello world!see you world!"));
+    BOOST_CHECK(std::equal(t.begin(), t.end(), mac.begin()));
+    crypto::cleanse(key);                                      // clear sensitive data
+}
 
 BOOST_AUTO_TEST_CASE(encryption)
 {
@@ -103,5 +165,51 @@ BOOST_AUTO_TEST_CASE(encryption)
         cipher.transform(ciphertext, decrypted);               // try decryption again
         BOOST_CHECK_THROW(cipher.verify(), std::runtime_error);
     }
+
+    boost::array<unsigned char, 8> short_seal;                 // truncated seals are refused
+    std::copy(seal.begin(), seal.begin() + short_seal.size(), short_seal.begin());
+    {
+        crypto::cipher cipher(key, iv);
+        cipher.transform(text, ciphertext);
+        BOOST_CHECK_THROW(cipher.seal(short_seal), std::runtime_error);
+    }
+    BOOST_CHECK_THROW(crypto::cipher(key, iv, short_seal), std::runtime_error);
     crypto::cleanse(key);                                      // clear sensitive data
 }
+
+BOOST_AUTO_TEST_CASE(encryption_in_chunks)
+{
+    boost::array<unsigned char, 32> key;                       // AES-256 key
+    boost::array<unsigned char, 12> iv;                        // GCM-native nonce size
+    crypto::block seal, chunked_seal;
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+    std::vector<unsigned char> text(1000);
+    crypto::fill_random(text);
+
+    std::vector<unsigned char> whole(text.size());
+    {
+        crypto::cipher cipher(key, iv);
+        cipher.transform(text, whole);
+        cipher.seal(seal);
+    }
+
+    std::vector<unsigned char> chunked(text.size());
+    {
+        crypto::cipher cipher(key, iv);                        // odd-sized chunks, same result
+        for (size_t pos = 0, step = 1; pos < text.size(); pos += step, step += 7) {
+            size_t n = std::min(step, text.size() - pos);
+            cipher.transform(&text[pos], &chunked[pos], n);
+        }
+        cipher.seal(chunked_seal);
+    }
+    BOOST_CHECK(whole == chunked);
+    BOOST_CHECK(seal == chunked_seal);
+
+    {
+        crypto::cipher cipher(key, iv, seal);                  // decrypt in place
+        cipher.transform(chunked, chunked);
+        cipher.verify();
+    }
+    BOOST_CHECK(chunked == text);
+}
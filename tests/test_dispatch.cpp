@@ -0,0 +1,141 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_dispatch
+#include <boost/test/unit_test.hpp>
+#include <cstdlib>
+
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/aes_128_ctr.h"
+#include "krypto/aes_256_ctr.h"
+
+using namespace crypto::dispatch;
+
+namespace {
+
+const impl all_impls[] = { impl::portable, impl::openssl, impl::aesni, impl::vaes, impl::shani,
+                             impl::avx2, impl::avx512 };
+
+// Encrypt the same data with every kernel the host supports and compare to portable code.
+template <typename Cipher>
+void check_kernels_agree(primitive p)
+{
+    impl original = selected(p);
+
+    std::vector<char> key(Cipher::key_size);
+    crypto::block iv;
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+    std::vector<unsigned char> text(4096 + 77), expected(text.size()), out(text.size());
+    crypto::fill_random(text);
+
+    BOOST_REQUIRE(force(p, impl::portable));
+    Cipher(key).encrypt(text, expected, iv);
+
+    for (impl i : all_impls)
+    {
+        if (!force(p, i)) {
+            continue;
+        }
+        BOOST_TEST_MESSAGE(name(i));
+        Cipher(key).encrypt(text, out, iv);
+        BOOST_CHECK(out == expected);
+    }
+
+    force(p, original);
+    crypto::cleanse(key);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(selection)
+{
+    for (primitive p : { primitive::aes_128_ctr, primitive::aes_256_ctr, primitive::aes_256_cbc,
+                         primitive::xsalsa20, primitive::sha256, primitive::sha512,
+                         primitive::sha256_batch })
+    {
+        BOOST_CHECK(supported(p, selected(p)));
+        BOOST_CHECK(supported(p, impl::portable));
+        BOOST_TEST_MESSAGE(implementation(p));
+    }
+    BOOST_CHECK(!force(primitive::xsalsa20, impl::aesni));
+    BOOST_CHECK(!force(primitive::sha256, impl::vaes));
+    BOOST_CHECK(!force(primitive::sha512, impl::shani));
+    BOOST_CHECK(supported(primitive::sha256, impl::shani) == (cpu().sha and cpu().sse41));
+    BOOST_CHECK(supported(primitive::aes_256_ctr, impl::vaes) == cpu().vaes);
+    BOOST_CHECK(supported(primitive::sha256_batch, impl::avx2) == cpu().avx2);
+    BOOST_CHECK(!force(primitive::sha256, impl::avx2));
+    if (!std::getenv("KRYPTO_IMPL")) {
+        BOOST_CHECK(selected(primitive::sha512) == impl::portable);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(hash_kernels_agree)
+{
+    std::vector<unsigned char> data(1000);
+    crypto::fill_random(data);
+
+    for (primitive p : { primitive::sha256, primitive::sha512 })
+    {
+        impl original = selected(p);
+        std::vector<std::vector<unsigned char>> digests;
+        for (impl i : all_impls)
+        {
+            if (!force(p, i)) {
+                continue;
+            }
+            BOOST_TEST_MESSAGE(name(i));
+            hash_kernel const& k = p == primitive::sha256 ? sha256() : sha512();
+
+            // Lengths around the padding boundaries of both block sizes.
+            for (size_t size : { 0, 1, 55, 56, 63, 64, 111, 112, 127, 128, 1000 })
+            {
+                std::vector<unsigned char> one_shot(64), incremental(64), forked(64), prefix(64);
+                k.hash(data.data(), size, one_shot.data());
+                k.hash(data.data(), size / 3, prefix.data());
+
+                // A copied state carries on independently of the original.
+                alignas(16) unsigned char state[hash_state_size], fork[hash_state_size];
+                k.init(state);
+                k.update(state, data.data(), size / 3);
+                k.copy(fork, state);
+                k.update(state, data.data() + size / 3, size - size / 3);
+                k.final(state, incremental.data());
+                k.update(fork, data.data() + size / 3, size - size / 3);
+                k.final(fork, forked.data());
+                k.discard(fork);
+
+                BOOST_CHECK(one_shot == incremental);
+                BOOST_CHECK(one_shot == forked);
+
+                // A finished state starts over in place.
+                k.reset(state);
+                k.update(state, data.data(), size / 3);
+                k.copy(fork, state);
+                k.update(state, data.data(), 1);
+                k.discard(state);
+                k.final(fork, incremental.data());
+                k.discard(fork);
+                BOOST_CHECK(prefix == incremental);
+                digests.push_back(one_shot);
+            }
+        }
+        BOOST_REQUIRE(digests.size() >= 22);
+        for (size_t j = 11; j < digests.size(); ++j) {
+            BOOST_CHECK(digests[j] == digests[j % 11]);
+        }
+        force(p, original);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(aes_kernels_agree)
+{
+    check_kernels_agree<crypto::aes_128_ctr>(primitive::aes_128_ctr);
+    check_kernels_agree<crypto::aes_256_ctr>(primitive::aes_256_ctr);
+}
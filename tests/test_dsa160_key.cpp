@@ -0,0 +1,228 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_dsa160_key
+// The tests cross-check against OpenSSL's own, deprecated, DSA calls.
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <openssl/dsa.h>
+
+#include "krypto/krypto.h"
+#include "krypto/dsa160_key.h"
+#include "krypto/sha256_hash.h"
+#include "krypto/utils.h"
+#include "arsenal/byte_array_wrap.h"
+#include "arsenal/flurry.h"
+
+using crypto::dsa160_key;
+
+namespace {
+
+byte_array digest_of(std::string const& text)
+{
+    return crypto::sha256::to_byte_array(crypto::sha256::hash(byte_array(text)));
+}
+
+/// OpenSSL's own DSA object for a serialized dsa160_key.
+DSA* openssl_key(byte_array const& blob)
+{
+    BIGNUM *p = nullptr, *q = nullptr, *g = nullptr, *pub_key = nullptr, *priv_key = nullptr;
+    byte_array_iwrap<flurry::iarchive> read(blob);
+    read.archive() >> p >> q >> g >> pub_key >> priv_key;
+    if (BN_is_zero(priv_key))
+    {
+        BN_free(priv_key);
+        priv_key = nullptr;
+    }
+    DSA* dsa = DSA_new();
+    DSA_set0_pqg(dsa, p, q, g);
+    DSA_set0_key(dsa, pub_key, priv_key);
+    return dsa;
+}
+
+/// dsa160_key serialization of an OpenSSL key.
+byte_array key_blob(DSA const* dsa)
+{
+    BIGNUM const *p, *q, *g, *pub_key, *priv_key;
+    DSA_get0_pqg(dsa, &p, &q, &g);
+    DSA_get0_key(dsa, &pub_key, &priv_key);
+    byte_array data;
+    {
+        byte_array_owrap<flurry::oarchive> write(data);
+        write.archive() << p << q << g << pub_key << priv_key;
+    }
+    return data;
+}
+
+/// The dsa160_key signature as an OpenSSL DSA_SIG.
+DSA_SIG* parse_signature(byte_array const& signature)
+{
+    BIGNUM *r = nullptr, *s = nullptr;
+    byte_array_iwrap<flurry::iarchive> read(signature);
+    read.archive() >> r >> s;
+    DSA_SIG* sig = DSA_SIG_new();
+    DSA_SIG_set0(sig, r, s);
+    return sig;
+}
+
+byte_array encode_signature(DSA_SIG const* sig)
+{
+    BIGNUM const *r, *s;
+    DSA_SIG_get0(sig, &r, &s);
+    byte_array signature;
+    {
+        byte_array_owrap<flurry::oarchive> write(signature);
+        write.archive() << r << s;
+    }
+    return signature;
+}
+
+std::string r_of(DSA_SIG const* sig)
+{
+    BIGNUM const* r;
+    DSA_SIG_get0(sig, &r, nullptr);
+    char* hex = BN_bn2hex(r);
+    std::string result(hex);
+    OPENSSL_free(hex);
+    return result;
+}
+
+/// Our signatures pass DSA_do_verify() and OpenSSL's pass ours, on 160 bits of the digest.
+void check_interoperates(dsa160_key const& key, DSA* dsa)
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        byte_array digest = digest_of("message " + std::to_string(i));
+        unsigned char const* m = (unsigned char const*)digest.const_data();
+
+        byte_array signature = key.sign(digest);
+        DSA_SIG* sig = parse_signature(signature);
+        BOOST_CHECK(DSA_do_verify(m, 160/8, sig, dsa) == 1);
+        BOOST_CHECK(key.verify(digest, signature));
+        BOOST_CHECK(!key.verify(digest_of("other message"), signature));
+        DSA_SIG_free(sig);
+
+        DSA_SIG* theirs = DSA_do_sign(m, 160/8, dsa);
+        BOOST_REQUIRE(theirs);
+        BOOST_CHECK(key.verify(digest, encode_signature(theirs)));
+        DSA_SIG_free(theirs);
+    }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(standard_group_interoperates)
+{
+    dsa160_key key(1024);
+    BOOST_REQUIRE(key.type() == crypto::sign_key::public_and_private);
+    BOOST_CHECK(key.id().size() == 160/8);
+
+    DSA* dsa = openssl_key(key.private_key());
+    check_interoperates(key, dsa);
+
+    dsa160_key verifier(key.public_key());
+    BOOST_CHECK(verifier.type() == crypto::sign_key::public_only);
+    BOOST_CHECK(verifier.id() == key.id());
+    byte_array digest = digest_of("public only");
+    BOOST_CHECK(verifier.verify(digest, key.sign(digest)));
+    BOOST_CHECK_THROW(verifier.sign(digest), std::runtime_error);
+
+    dsa160_key restored(key.private_key());
+    BOOST_CHECK(restored.type() == crypto::sign_key::public_and_private);
+    check_interoperates(restored, dsa);
+    DSA_free(dsa);
+}
+
+BOOST_AUTO_TEST_CASE(other_group_interoperates)
+{
+    DSA* dsa = DSA_new();
+    BOOST_REQUIRE(DSA_generate_parameters_ex(dsa, 1024, nullptr, 0, nullptr, nullptr, nullptr) == 1);
+    BOOST_REQUIRE(DSA_generate_key(dsa) == 1);
+
+    dsa160_key key(key_blob(dsa));
+    BOOST_REQUIRE(key.type() == crypto::sign_key::public_and_private);
+    check_interoperates(key, dsa);
+
+    key.set_precompute({4, 2});
+    check_interoperates(key, dsa);
+    DSA_free(dsa);
+}
+
+BOOST_AUTO_TEST_CASE(precomputed_pairs_are_used_once)
+{
+    dsa160_key key(1024);
+    DSA* dsa = openssl_key(key.private_key());
+
+    // Refill only once the pool is empty, so the first signatures all come from it.
+    size_t const capacity = 16;
+    key.set_precompute({capacity, 1});
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (key.precompute_statistics().available < capacity
+           and std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    BOOST_REQUIRE(key.precompute_statistics().available == capacity);
+
+    std::set<std::string> rs;
+    for (size_t i = 0; i < 3 * capacity; ++i)
+    {
+        byte_array digest = digest_of("pooled " + std::to_string(i));
+        DSA_SIG* sig = parse_signature(key.sign(digest));
+        BOOST_CHECK(DSA_do_verify((unsigned char const*)digest.const_data(), 160/8, sig, dsa) == 1);
+        BOOST_CHECK(rs.insert(r_of(sig)).second);
+        DSA_SIG_free(sig);
+
+        if (i + 1 == capacity)
+        {
+            dsa160_key::precompute_stats stats = key.precompute_statistics();
+            BOOST_CHECK(stats.hits == capacity);
+            BOOST_CHECK(stats.misses == 0);
+        }
+    }
+    BOOST_CHECK(rs.size() == 3 * capacity);
+
+    dsa160_key::precompute_stats stats = key.precompute_statistics();
+    BOOST_CHECK(stats.hits + stats.misses == 3 * capacity);
+    key.set_precompute({0, 0});
+    DSA_free(dsa);
+}
+
+BOOST_AUTO_TEST_CASE(malformed_keys_are_invalid)
+{
+    dsa160_key good(1024);
+    byte_array digest = digest_of("nothing");
+    byte_array signature = good.sign(digest);
+    byte_array truncated = good.private_key();
+    truncated.resize(truncated.size() / 2);
+
+    DSA* dsa = openssl_key(good.private_key());
+    BIGNUM const *p, *q, *g;
+    DSA_get0_pqg(dsa, &p, &q, &g);
+    BIGNUM* even = BN_dup(q);
+    BN_add_word(even, 1);
+    DSA* broken = DSA_new();
+    DSA_set0_pqg(broken, BN_dup(p), even, BN_dup(g));
+    BIGNUM const *pub_key, *priv_key;
+    DSA_get0_key(dsa, &pub_key, &priv_key);
+    DSA_set0_key(broken, BN_dup(pub_key), BN_dup(priv_key));
+
+    for (byte_array const& blob : { byte_array(), truncated, key_blob(broken) })
+    {
+        dsa160_key key(blob);
+        BOOST_CHECK(key.type() == crypto::sign_key::invalid);
+        BOOST_CHECK_THROW(key.sign(digest), std::runtime_error);
+        BOOST_CHECK(!key.verify(digest, signature));
+    }
+    BOOST_CHECK(!good.verify(digest, byte_array()));
+    DSA_free(broken);
+    DSA_free(dsa);
+}
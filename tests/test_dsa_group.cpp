@@ -0,0 +1,195 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_dsa_group
+// The tests cross-check against OpenSSL's own, deprecated, DSA calls.
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <openssl/dsa.h>
+
+#include "krypto/dsa_group.h"
+
+using crypto::dsa_group;
+
+namespace {
+
+/// s = k^-1 (m + x r) mod q
+BIGNUM* sign_with(dsa_group const* group, BIGNUM const* x, BIGNUM const* kinv, BIGNUM const* r,
+                  unsigned char const* digest)
+{
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* m = BN_bin2bn(digest, 20, nullptr);
+    BIGNUM* s = BN_new();
+    BN_mod_mul(s, x, r, group->q(), ctx);
+    BN_mod_add(s, s, m, group->q(), ctx);
+    BN_mod_mul(s, s, kinv, group->q(), ctx);
+    BN_free(m);
+    BN_CTX_free(ctx);
+    return s;
+}
+
+/// OpenSSL's own DSA key for x and y in the group.
+DSA* openssl_key(dsa_group const* group, BIGNUM const* x, BIGNUM const* y)
+{
+    DSA* dsa = DSA_new();
+    DSA_set0_pqg(dsa, BN_dup(group->p()), BN_dup(group->q()), BN_dup(group->g()));
+    DSA_set0_key(dsa, BN_dup(y), BN_dup(x));
+    return dsa;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(standard_groups)
+{
+    BOOST_CHECK(dsa_group::standard(512) == nullptr);
+    for (int bits : {1024, 2048, 3072})
+    {
+        dsa_group const* group = dsa_group::standard(bits);
+        BOOST_REQUIRE(group);
+        BOOST_CHECK(dsa_group::standard(bits) == group);
+        BOOST_CHECK(BN_num_bits(group->p()) == bits);
+        BOOST_CHECK(BN_num_bits(group->q()) == 160);
+        BOOST_CHECK(dsa_group::find(group->p(), group->q(), group->g()) == group);
+    }
+    dsa_group const* g1 = dsa_group::standard(1024);
+    dsa_group const* g2 = dsa_group::standard(2048);
+    BOOST_CHECK(dsa_group::find(g1->p(), g1->q(), g2->g()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(fixed_base_power)
+{
+    BN_CTX* ctx = BN_CTX_new();
+    BIGNUM* e = BN_new();
+    BIGNUM* expected = BN_new();
+    BIGNUM* actual = BN_new();
+
+    for (int bits : {1024, 2048, 3072})
+    {
+        dsa_group const* group = dsa_group::standard(bits);
+        std::vector<BIGNUM*> exponents;
+        exponents.push_back(BN_new());                      // 0
+        exponents.push_back(BN_dup(BN_value_one()));        // 1
+        exponents.push_back(BN_dup(group->q()));
+        BN_sub_word(exponents.back(), 1);                   // q - 1
+        for (int i = 0; i < 20; ++i)
+        {
+            exponents.push_back(BN_new());
+            BN_rand_range(exponents.back(), group->q());
+        }
+        exponents.push_back(BN_new());
+        BN_rand(exponents.back(), 300, 0, 0);               // larger than q
+
+        for (BIGNUM* x : exponents)
+        {
+            BOOST_REQUIRE(group->pow_g(actual, x, ctx));
+            // g has order q, so g^x = g^(x mod q).
+            BN_nnmod(e, x, group->q(), ctx);
+            BN_mod_exp(expected, group->g(), e, group->p(), ctx);
+            BOOST_CHECK(BN_cmp(actual, expected) == 0);
+            BN_free(x);
+        }
+    }
+
+    BN_free(actual);
+    BN_free(expected);
+    BN_free(e);
+    BN_CTX_free(ctx);
+}
+
+BOOST_AUTO_TEST_CASE(sign_and_verify)
+{
+    unsigned char digest[20], other[20];
+    for (int i = 0; i < 20; ++i)
+    {
+        digest[i] = (unsigned char)(i * 13 + 1);
+        other[i] = digest[i];
+    }
+    other[19] ^= 1;
+
+    BN_CTX* ctx = BN_CTX_new();
+    for (int bits : {1024, 2048, 3072})
+    {
+        dsa_group const* group = dsa_group::standard(bits);
+        BIGNUM *x, *y, *kinv, *r;
+        BOOST_REQUIRE(group->generate(&x, &y));
+        BOOST_REQUIRE(group->sign_setup(ctx, &kinv, &r));
+        BIGNUM* s = sign_with(group, x, kinv, r, digest);
+
+        BOOST_CHECK(group->verify(digest, 20, r, s, y));
+        BOOST_CHECK(!group->verify(other, 20, r, s, y));
+        BOOST_CHECK(!group->verify(digest, 20, s, r, y));
+
+        BIGNUM* zero = BN_new();
+        BOOST_CHECK(!group->verify(digest, 20, zero, s, y));
+        BIGNUM* big = BN_dup(s);
+        BN_add(big, big, group->q());   // same value mod q, but out of range
+        BOOST_CHECK(!group->verify(digest, 20, r, big, y));
+
+        // Our signature passes OpenSSL, and OpenSSL's passes ours.
+        DSA* dsa = openssl_key(group, x, y);
+        DSA_SIG* sig = DSA_SIG_new();
+        DSA_SIG_set0(sig, BN_dup(r), BN_dup(s));
+        BOOST_CHECK(DSA_do_verify(digest, 20, sig, dsa) == 1);
+        BOOST_CHECK(DSA_do_verify(other, 20, sig, dsa) != 1);
+        DSA_SIG_free(sig);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            DSA_SIG* theirs = DSA_do_sign(digest, 20, dsa);
+            BOOST_REQUIRE(theirs);
+            BIGNUM const *their_r, *their_s;
+            DSA_SIG_get0(theirs, &their_r, &their_s);
+            BOOST_CHECK(group->verify(digest, 20, their_r, their_s, y));
+            BOOST_CHECK(!group->verify(other, 20, their_r, their_s, y));
+            DSA_SIG_free(theirs);
+        }
+        DSA_free(dsa);
+
+        for (BIGNUM* n : {x, y, kinv, r, s, zero, big}) {
+            BN_free(n);
+        }
+    }
+    BN_CTX_free(ctx);
+}
+
+BOOST_AUTO_TEST_CASE(shared_between_threads)
+{
+    dsa_group const* group = dsa_group::standard(2048);
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            BN_CTX* ctx = BN_CTX_new();
+            unsigned char digest[20] = {1, 2, 3};
+            for (int i = 0; i < 10; ++i)
+            {
+                BIGNUM *x, *y, *kinv, *r;
+                if (!group->generate(&x, &y) or !group->sign_setup(ctx, &kinv, &r))
+                {
+                    ++failures;
+                    continue;
+                }
+                BIGNUM* s = sign_with(group, x, kinv, r, digest);
+                if (!group->verify(digest, 20, r, s, y)) {
+                    ++failures;
+                }
+                for (BIGNUM* n : {x, y, kinv, r, s}) {
+                    BN_free(n);
+                }
+            }
+            BN_CTX_free(ctx);
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    BOOST_CHECK(failures == 0);
+}
@@ -0,0 +1,109 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_file_hash
+#include <boost/test/unit_test.hpp>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <unistd.h>
+
+#include "krypto/krypto.h"
+#include "krypto/file_hash.h"
+#include "krypto/hmac.h"
+
+using namespace crypto;
+
+namespace {
+
+/// Temporary file removed at scope exit.
+struct temp_file
+{
+    std::string path;
+
+    explicit temp_file(std::vector<unsigned char> const& contents)
+        : path("/tmp/krypto_test_file_hash_" + std::to_string(::getpid()))
+    {
+        std::ofstream out(path, std::ios::binary);
+        out.write((char const*)contents.data(), contents.size());
+    }
+
+    ~temp_file() { std::remove(path.c_str()); }
+};
+
+std::vector<unsigned char> random_bytes(size_t size)
+{
+    std::vector<unsigned char> data(size);
+    fill_random(data);
+    return data;
+}
+
+/// Signs with an HMAC, which is enough to check what gets signed.
+class mac_key : public sign_key
+{
+    hmac mac_;
+
+public:
+    mac_key() : mac_(byte_array("file signing test key")) { set_type(public_and_private); }
+
+    byte_array private_key() const override { return byte_array(); }
+
+    byte_array sign(byte_array const& digest) const override
+    {
+        hmac::tag t = mac_.sign(digest);
+        return byte_array((char const*)t.data(), t.size());
+    }
+
+    bool verify(byte_array const& digest, byte_array const& signature) const override
+    {
+        return signature.size() == hmac::tag_size
+            and mac_.verify((unsigned char const*)digest.const_data(), digest.size(),
+                            (unsigned char const*)signature.const_data());
+    }
+
+protected:
+    byte_array encode_public_key() const override { return byte_array(); }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(hash_matches_memory)
+{
+    // Sizes around the mapping window (16 MiB) as well as small and empty files.
+    for (size_t size : { 0, 1, 4095, 4096, 100000, (16 << 20) + 12345 })
+    {
+        std::vector<unsigned char> data = random_bytes(size);
+        temp_file file(data);
+        BOOST_CHECK(hash_file(file.path) == sha256::hash(data.data(), data.size()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unmappable_input)
+{
+    // /dev/null is not a regular file, so it goes through the read() path.
+    BOOST_CHECK(hash_file("/dev/null") == sha256::hash(byte_array()));
+    BOOST_CHECK_THROW(hash_file("/nonexistent/krypto/file"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(sign_and_verify)
+{
+    mac_key key;
+    std::vector<unsigned char> data = random_bytes(300000);
+    byte_array signature;
+    {
+        temp_file file(data);
+        signature = sign_file(key, file.path);
+        BOOST_CHECK(verify_file(key, file.path, signature));
+        BOOST_CHECK(key.verify(sha256::to_byte_array(sha256::hash(data.data(), data.size())),
+                               signature));
+    }
+
+    data[123456] ^= 1;
+    temp_file changed(data);
+    BOOST_CHECK(!verify_file(key, changed.path, signature));
+}
@@ -0,0 +1,154 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_hmac
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <memory>
+
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/hmac.h"
+
+using namespace crypto;
+
+namespace {
+
+template <typename C>
+std::string to_hex(C const& data, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < size; ++i) {
+        out += digits[data[i] >> 4];
+        out += digits[data[i] & 0xf];
+    }
+    return out;
+}
+
+std::string full_mac(hmac const& mac, std::string const& text)
+{
+    sha256::context ctx = mac.begin();
+    ctx.update(text);
+    unsigned char out[hmac::digest_size];
+    mac.finalize(ctx, out);
+    return to_hex(out, sizeof(out));
+}
+
+} // anonymous namespace
+
+// RFC 4231 test cases 1, 2, 5 and 6.
+BOOST_AUTO_TEST_CASE(rfc4231)
+{
+    const dispatch::impl impls[] = { dispatch::impl::portable, dispatch::impl::openssl,
+                                     dispatch::impl::shani };
+    dispatch::impl original = dispatch::selected(dispatch::primitive::sha256);
+
+    for (dispatch::impl i : impls)
+    {
+        if (!dispatch::force(dispatch::primitive::sha256, i)) {
+            continue;
+        }
+        BOOST_TEST_MESSAGE(dispatch::name(i));
+
+        BOOST_CHECK(full_mac(hmac(std::string(20, '\x0b')), "Hi There")
+            == "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7");
+        BOOST_CHECK(full_mac(hmac(std::string("Jefe")), "what do ya want for nothing?")
+            == "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843");
+        BOOST_CHECK(to_hex(hmac(std::string(20, '\x0c')).sign(byte_array("Test With Truncation")),
+                           hmac::tag_size)
+            == "a3b6167473100ee06e0c796c2955552b");
+        BOOST_CHECK(full_mac(hmac(std::string(131, '\xaa')),
+                             "Test Using Larger Than Block-Size Key - Hash Key First")
+            == "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54");
+    }
+
+    dispatch::force(dispatch::primitive::sha256, original);
+}
+
+BOOST_AUTO_TEST_CASE(sign_and_verify)
+{
+    block key;
+    fill_random(key);
+    hmac mac(key);
+
+    byte_array message("line packet payload");
+    hmac::tag t = mac.sign(message);
+    BOOST_CHECK(mac.verify(message, t));
+
+    // Pieces give the same result, and the context can be reused afterwards.
+    sha256::context ctx = mac.begin();
+    unsigned char full[hmac::digest_size];
+    for (int round = 0; round < 2; ++round)
+    {
+        ctx.update("line packet ");
+        ctx.update("payload");
+        mac.finalize(ctx, full);
+        BOOST_CHECK(std::equal(t.begin(), t.end(), full));
+    }
+
+    for (size_t i = 0; i < hmac::tag_size; ++i)
+    {
+        hmac::tag bad = t;
+        bad[i] ^= 0x80;
+        BOOST_CHECK(!mac.verify(message, bad));
+    }
+
+    block other;
+    fill_random(other);
+    BOOST_CHECK(!hmac(other).verify(message, t));
+    cleanse(key);
+}
+
+BOOST_AUTO_TEST_CASE(batch)
+{
+    hmac mac(byte_array("0123456789abcdef0123456789abcdef"));
+
+    // More messages than one multi-buffer group, of sizes around the padding boundaries.
+    const size_t count = 100;
+    std::vector<std::vector<unsigned char>> messages(count);
+    std::vector<unsigned char const*> data(count);
+    std::vector<size_t> sizes(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        messages[i].resize(i * 13 % 200);
+        fill_random(messages[i]);
+        data[i] = messages[i].data();
+        sizes[i] = messages[i].size();
+    }
+
+    const dispatch::impl impls[] = { dispatch::impl::portable, dispatch::impl::avx2,
+                                     dispatch::impl::avx512 };
+    dispatch::impl original = dispatch::selected(dispatch::primitive::sha256_batch);
+
+    for (dispatch::impl i : impls)
+    {
+        if (!dispatch::force(dispatch::primitive::sha256_batch, i)) {
+            continue;
+        }
+        BOOST_TEST_MESSAGE(dispatch::name(i));
+
+        std::vector<unsigned char> tags(count * hmac::tag_size);
+        mac.sign(data.data(), sizes.data(), count, tags.data());
+        for (size_t j = 0; j < count; ++j)
+        {
+            hmac::tag t = mac.sign(data[j], sizes[j]);
+            BOOST_CHECK(std::equal(t.begin(), t.end(), tags.begin() + j * hmac::tag_size));
+        }
+
+        tags[5 * hmac::tag_size] ^= 1;
+        tags[70 * hmac::tag_size + 15] ^= 0x80;
+        std::unique_ptr<bool[]> ok(new bool[count]);
+        BOOST_CHECK(mac.verify(data.data(), sizes.data(), count, tags.data(), ok.get()) == count - 2);
+        for (size_t j = 0; j < count; ++j) {
+            BOOST_CHECK(ok[j] == (j != 5 and j != 70));
+        }
+    }
+
+    dispatch::force(dispatch::primitive::sha256_batch, original);
+}
@@ -0,0 +1,125 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_key_pool
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <stdexcept>
+#include <thread>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/key_pool.h"
+#include "test_keys.h"
+
+using crypto::key_pool;
+using crypto::nacl_sign_key;
+
+namespace {
+
+/// Wait until @a kind has @a n keys ready. The deadline only guards against a
+/// hang; the tests do not depend on how fast keys appear.
+bool wait_ready(key_pool const& pool, std::string const& kind, size_t n)
+{
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (pool.statistics(kind).ready < n)
+    {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+slow_key const& as_slow(key_pool::key_ptr const& key)
+{
+    return dynamic_cast<slow_key const&>(*key);
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(ready_keys)
+{
+    key_pool pool(2);
+    pool.add("ed25519", 8, key_pool::make<nacl_sign_key>());
+    BOOST_REQUIRE(wait_ready(pool, "ed25519", 8));
+
+    std::set<byte_array> ids;
+    for (int i = 0; i < 8; ++i)
+    {
+        key_pool::key_ptr key = pool.take("ed25519");
+        BOOST_REQUIRE(key);
+        BOOST_CHECK(key->type() == crypto::sign_key::public_and_private);
+        ids.insert(key->id());
+    }
+    BOOST_CHECK(ids.size() == 8);
+    BOOST_CHECK(pool.statistics("ed25519").taken == 8);
+    BOOST_CHECK(pool.statistics("ed25519").starved == 0);
+
+    // The pool refills behind the takers.
+    BOOST_CHECK(wait_ready(pool, "ed25519", 8));
+    BOOST_CHECK_THROW(pool.take("rsa1024"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(starvation_falls_back)
+{
+    key_pool pool(1);
+    pool.add("slow", 2, key_pool::make<slow_key>(20));
+
+    // Nothing is ready yet: try_take() gives up, take() generates here.
+    BOOST_CHECK(!pool.try_take("slow"));
+    key_pool::key_ptr key = pool.take("slow");
+    BOOST_REQUIRE(key);
+    BOOST_CHECK(as_slow(key).made_on == std::this_thread::get_id());
+
+    key_pool::stats s = pool.statistics("slow");
+    BOOST_CHECK(s.starved == 2);
+    BOOST_CHECK(s.taken == 1);
+
+    // Once keys are ready they come from the generator thread, without starving.
+    BOOST_REQUIRE(wait_ready(pool, "slow", 2));
+    key = pool.take("slow");
+    BOOST_REQUIRE(key);
+    BOOST_CHECK(as_slow(key).made_on != std::this_thread::get_id());
+    s = pool.statistics("slow");
+    BOOST_CHECK(s.starved == 2);
+    BOOST_CHECK(s.taken == 2);
+}
+
+BOOST_AUTO_TEST_CASE(kinds_share_workers)
+{
+    key_pool::key_ptr kept;
+    {
+        key_pool pool(1);
+        pool.add("slow", 3, key_pool::make<slow_key>(5));
+        pool.add("fast", 3, key_pool::make<nacl_sign_key>());
+        BOOST_CHECK(wait_ready(pool, "fast", 3));
+        BOOST_CHECK(wait_ready(pool, "slow", 3));
+
+        // A smaller depth drops the surplus; zero turns the kind off. The single
+        // worker fills a new probe kind only after passing over "slow", so once
+        // the probe is ready no slow key can have been made in the meantime.
+        pool.add("slow", 0, key_pool::make<slow_key>(5));
+        BOOST_CHECK(pool.statistics("slow").ready == 0);
+        int made = slow_key::made();
+        pool.add("probe", 1, key_pool::make<nacl_sign_key>());
+        BOOST_CHECK(wait_ready(pool, "probe", 1));
+        BOOST_CHECK(slow_key::made() == made);
+
+        pool.add("slow", 50, key_pool::make<slow_key>(5));
+        kept = pool.take("slow");
+    }
+    // Destroying the pool waits for the key being generated and frees every
+    // ready one; only the key taken out is left.
+    BOOST_CHECK(slow_key::alive() == 1);
+    kept.reset();
+    BOOST_CHECK(slow_key::alive() == 0);
+}
@@ -0,0 +1,191 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_key_registry
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/key_registry.h"
+#include "krypto/sha256_hash.h"
+#include "test_keys.h"
+
+using crypto::key_registry;
+using crypto::nacl_sign_key;
+
+namespace {
+
+bool starts_with(byte_array const& id, byte_array const& prefix)
+{
+    return std::memcmp(id.const_data(), prefix.const_data(), prefix.size()) == 0;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(insert_find_erase)
+{
+    key_registry registry;
+    std::vector<std::shared_ptr<blob_key>> keys;
+    for (int i = 0; i < 1000; ++i)
+    {
+        keys.push_back(std::make_shared<blob_key>());
+        BOOST_CHECK(registry.insert(keys.back()));
+    }
+    BOOST_CHECK(registry.size() == 1000);
+    BOOST_CHECK(!registry.insert(keys[3]));
+    BOOST_CHECK(!registry.insert(nullptr));
+
+    for (auto const& key : keys) {
+        BOOST_CHECK(registry.find(key->id()) == key);
+    }
+    BOOST_CHECK(!registry.find(digest_of("nobody")));
+
+    // Erase every other key; the rest must stay reachable past the holes.
+    for (size_t i = 0; i < keys.size(); i += 2) {
+        BOOST_CHECK(registry.erase(keys[i]->id()));
+    }
+    BOOST_CHECK(!registry.erase(keys[0]->id()));
+    BOOST_CHECK(registry.size() == 500);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        BOOST_CHECK((registry.find(keys[i]->id()) == keys[i]) == (i % 2 == 1));
+    }
+    BOOST_CHECK(registry.insert(keys[0]));
+    BOOST_CHECK(registry.find(keys[0]->id()) == keys[0]);
+}
+
+BOOST_AUTO_TEST_CASE(prefix_lookup)
+{
+    key_registry registry(10);
+    std::vector<std::shared_ptr<blob_key>> keys;
+    for (int i = 0; i < 3000; ++i)
+    {
+        keys.push_back(std::make_shared<blob_key>());
+        registry.insert(keys.back());
+    }
+
+    for (size_t length : {0, 1, 2, 3, 9})
+    {
+        for (int probe = 0; probe < 20; ++probe)
+        {
+            byte_array prefix = keys[probe * 101]->id();
+            prefix.resize(length);
+
+            size_t expected = std::count_if(keys.begin(), keys.end(),
+                [&](std::shared_ptr<blob_key> const& k) { return starts_with(k->id(), prefix); });
+            auto found = registry.find_prefix(prefix);
+            BOOST_CHECK(found.size() == expected);
+            for (auto const& k : found) {
+                BOOST_CHECK(starts_with(k->id(), prefix));
+            }
+        }
+    }
+    BOOST_CHECK(registry.find_prefix(byte_array()).size() == keys.size());
+}
+
+// Keys ground to share a home slot are stored up to max_probe slots away, then refused.
+BOOST_AUTO_TEST_CASE(crowded_home_region)
+{
+    key_registry registry;
+    const size_t ground = key_registry::max_probe + 40;
+    std::vector<std::shared_ptr<blob_key>> keys;
+    while (keys.size() < ground)
+    {
+        // The table stays at 512 slots, so the leading 9 bits are the home.
+        auto k = std::make_shared<blob_key>();
+        if ((unsigned char)k->id().const_data()[0] == 0x5a and (k->id().const_data()[1] & 0x80) == 0) {
+            keys.push_back(k);
+        }
+    }
+
+    size_t accepted = 0;
+    for (auto const& k : keys) {
+        accepted += registry.insert(k);
+    }
+    BOOST_CHECK(accepted == key_registry::max_probe + 1);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        BOOST_CHECK((registry.find(keys[i]->id()) == keys[i]) == (i < accepted));
+    }
+
+    auto other = std::make_shared<blob_key>();
+    BOOST_CHECK(registry.insert(other));
+    BOOST_CHECK(registry.find(other->id()) == other);
+}
+
+BOOST_AUTO_TEST_CASE(trial_verification)
+{
+    key_registry registry;
+    std::vector<std::shared_ptr<blob_key>> decoys;
+    for (int i = 0; i < 500; ++i)
+    {
+        decoys.push_back(std::make_shared<blob_key>());
+        registry.insert(decoys.back());
+    }
+    auto sender = std::make_shared<nacl_sign_key>();
+    registry.insert(sender);
+
+    byte_array digest = digest_of("open");
+    byte_array signature = sender->sign(digest);
+    BOOST_CHECK(registry.find_signer(digest, signature) == sender);
+    BOOST_CHECK(!registry.find_signer(digest_of("forged"), signature));
+
+    // Early exit: the signer at the front of the candidates stops the others.
+    std::vector<key_registry::key_ptr> candidates(1, sender);
+    candidates.insert(candidates.end(), decoys.begin(), decoys.end());
+    for (auto const& d : decoys) {
+        d->verifies = 0;
+    }
+    BOOST_CHECK(key_registry::find_signer(candidates, digest, signature) == sender);
+    int tried = 0;
+    for (auto const& d : decoys) {
+        tried += d->verifies;
+    }
+    BOOST_TEST_MESSAGE("decoys tried after an early match: " << tried << " of " << decoys.size());
+    BOOST_CHECK(tried < int(decoys.size()));
+
+    // With several keys that verify, the earliest candidate wins whichever segment finishes first.
+    std::vector<key_registry::key_ptr> twice(decoys.begin(), decoys.end());
+    auto again = std::make_shared<nacl_sign_key>(sender->private_key());
+    twice.insert(twice.begin() + 100, sender);
+    twice.push_back(again);
+    for (int round = 0; round < 20; ++round) {
+        BOOST_CHECK(key_registry::find_signer(twice, digest, signature) == sender);
+    }
+
+    BOOST_CHECK(!key_registry::find_signer({}, digest, signature));
+}
+
+BOOST_AUTO_TEST_CASE(many_peers)
+{
+    // Enough keys to grow the table several times; timings are in benchmarks/.
+    const size_t count = 5000;
+    std::vector<std::shared_ptr<blob_key>> keys;
+    keys.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        keys.push_back(std::make_shared<blob_key>());
+    }
+
+    key_registry registry;
+    for (auto const& k : keys) {
+        registry.insert(k);
+    }
+    size_t hits = 0;
+    for (auto const& k : keys) {
+        hits += registry.find(k->id()) == k;
+    }
+
+    BOOST_CHECK(hits == count);
+    BOOST_CHECK(registry.size() == count);
+
+    byte_array prefix = keys[0]->id();
+    prefix.resize(3);
+    auto found = registry.find_prefix(prefix);
+    BOOST_CHECK(std::find(found.begin(), found.end(), keys[0]) != found.end());
+}
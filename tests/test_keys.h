@@ -0,0 +1,147 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Instrumented and fake sign_key classes shared by the key tests.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/sha256_hash.h"
+#include "krypto/sign_key.h"
+
+inline byte_array digest_of(std::string const& text)
+{
+    return crypto::sha256::to_byte_array(crypto::sha256::hash(byte_array(text)));
+}
+
+/// Ed25519 key that counts how often it really encodes its public key and verifies.
+class counting_key : public crypto::nacl_sign_key
+{
+public:
+    mutable std::atomic<int> encodes{0};
+    mutable std::atomic<int> verifies{0};
+
+    bool verify(byte_array const& digest, byte_array const& signature) const override
+    {
+        ++verifies;
+        return nacl_sign_key::verify(digest, signature);
+    }
+
+protected:
+    byte_array encode_public_key() const override
+    {
+        ++encodes;
+        return nacl_sign_key::encode_public_key();
+    }
+};
+
+/// Public-only key with a given or random blob that verifies nothing,
+/// cheap enough to make by the hundred thousand.
+class blob_key : public crypto::sign_key
+{
+    byte_array key_;
+    size_t id_size_;
+
+public:
+    mutable std::atomic<int> verifies{0};
+
+    /// A random 32-byte blob.
+    blob_key()
+        : id_size_(sign_key::id_size())
+    {
+        key_.resize(32);
+        crypto::fill_random(key_.as_vector());
+        set_type(public_only);
+    }
+
+    /// The given blob, with ids of @a id_size bytes (20 for rsa160_key-like ids).
+    blob_key(byte_array const& key, size_t id_size)
+        : key_(key)
+        , id_size_(id_size)
+    {
+        set_type(public_only);
+    }
+
+    byte_array private_key() const override { return byte_array(); }
+    byte_array sign(byte_array const&) const override { return byte_array(); }
+
+    bool verify(byte_array const&, byte_array const&) const override
+    {
+        ++verifies;
+        return false;
+    }
+
+protected:
+    byte_array encode_public_key() const override { return key_; }
+    size_t id_size() const override { return id_size_; }
+};
+
+/// Signs by handing back the digest itself; refuses empty digests.
+class echo_signer : public crypto::sign_key
+{
+public:
+    echo_signer()
+    {
+        set_type(public_and_private);
+    }
+
+    byte_array private_key() const override { return byte_array(); }
+
+    byte_array sign(byte_array const& digest) const override
+    {
+        if (digest.size() == 0) {
+            throw std::runtime_error("nothing to sign");
+        }
+        return digest;
+    }
+
+    bool verify(byte_array const& digest, byte_array const& signature) const override
+    {
+        return digest == signature;
+    }
+
+protected:
+    byte_array encode_public_key() const override { return byte_array(); }
+};
+
+/// Ed25519 key that takes its time to generate, like an RSA key.
+class slow_key : public crypto::nacl_sign_key
+{
+public:
+    /// Thread that generated this key.
+    std::thread::id const made_on{std::this_thread::get_id()};
+
+    /// Number of slow keys constructed so far.
+    static std::atomic<int>& made()
+    {
+        static std::atomic<int> count{0};
+        return count;
+    }
+
+    /// Number of slow keys not yet destroyed.
+    static std::atomic<int>& alive()
+    {
+        static std::atomic<int> count{0};
+        return count;
+    }
+
+    explicit slow_key(int ms)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        ++made();
+        ++alive();
+    }
+
+    ~slow_key() { --alive(); }
+};
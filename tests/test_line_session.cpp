@@ -0,0 +1,180 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_line_session
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <set>
+
+#include "krypto/krypto.h"
+#include "krypto/line_session.h"
+#include "krypto/sha256_hash.h"
+
+// Count heap allocations to check the steady-state packet path.
+// Out of line, so that the compiler does not pair malloc/free with new/delete.
+static std::atomic<size_t> allocations{0};
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    ++allocations;
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace {
+
+byte_array random_bytes(size_t size)
+{
+    byte_array out;
+    out.resize(size);
+    crypto::fill_random(out.as_vector());
+    return out;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(peers_interoperate)
+{
+    byte_array secret = random_bytes(32);
+    byte_array a_line = random_bytes(crypto::line_session::line_id_size);
+    byte_array b_line = random_bytes(crypto::line_session::line_id_size);
+
+    crypto::line_session a(secret, a_line, b_line);
+    crypto::line_session b(secret, b_line, a_line);
+
+    std::vector<unsigned char> text(1400), wire(text.size()), back(text.size());
+    crypto::fill_random(text);
+    unsigned char iv[crypto::line_session::iv_size];
+
+    a.encrypt(text.data(), wire.data(), wire.size(), iv);
+    b.decrypt(wire.data(), back.data(), back.size(), iv);
+    BOOST_CHECK(text == back);
+    BOOST_CHECK(wire != text);
+
+    b.encrypt(text.data(), wire.data(), wire.size(), iv);
+    a.decrypt(wire.data(), back.data(), back.size(), iv);
+    BOOST_CHECK(text == back);
+}
+
+BOOST_AUTO_TEST_CASE(keys_follow_telehash_derivation)
+{
+    byte_array secret = random_bytes(32);
+    byte_array mine = random_bytes(16);
+    byte_array theirs = random_bytes(16);
+
+    crypto::sha256::context forward, backward;
+    forward.update(secret);
+    forward.update(mine);
+    forward.update(theirs);
+    backward.update(secret);
+    backward.update(theirs);
+    backward.update(mine);
+    byte_array encrypt_key = crypto::sha256::to_byte_array(forward.finalize());
+    byte_array decrypt_key = crypto::sha256::to_byte_array(backward.finalize());
+
+    crypto::line_session derived(secret, mine, theirs);
+    crypto::line_session explicit_keys(encrypt_key, decrypt_key);
+
+    std::vector<unsigned char> text(100), wire(text.size()), back(text.size());
+    crypto::fill_random(text);
+    unsigned char iv[crypto::line_session::iv_size];
+
+    derived.encrypt(text.data(), wire.data(), wire.size(), iv);
+    crypto::aes_256_ctr(encrypt_key).decrypt(wire.data(), back.data(), back.size(), iv);
+    BOOST_CHECK(text == back);
+
+    explicit_keys.encrypt(text.data(), wire.data(), wire.size(), iv);
+    crypto::line_session peer(decrypt_key, encrypt_key);
+    peer.decrypt(wire.data(), back.data(), back.size(), iv);
+    BOOST_CHECK(text == back);
+}
+
+BOOST_AUTO_TEST_CASE(nonces_never_repeat)
+{
+    crypto::line_session line(random_bytes(32), random_bytes(32));
+    std::set<std::vector<unsigned char>> seen;
+    unsigned char data[16] = {0};
+    unsigned char iv[crypto::line_session::iv_size];
+
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        line.encrypt(data, data, sizeof(data), iv);
+        BOOST_CHECK(seen.insert(std::vector<unsigned char>(iv, iv + sizeof(iv))).second);
+        // Packet number in the middle, block counter starts at zero.
+        BOOST_CHECK_EQUAL(iv[10], (i >> 8) & 0xff);
+        BOOST_CHECK_EQUAL(iv[11], i & 0xff);
+        BOOST_CHECK_EQUAL(iv[15], 0);
+    }
+    BOOST_CHECK_EQUAL(line.packets_sent(), 1000u);
+}
+
+namespace crypto {
+struct line_session_access
+{
+    static void set_sent(line_session& line, uint64_t n) { line.sent_ = n; }
+};
+} // crypto namespace
+
+BOOST_AUTO_TEST_CASE(nonce_space_exhaustion)
+{
+    crypto::line_session line(random_bytes(32), random_bytes(32));
+    unsigned char data[16] = {0};
+    unsigned char iv[crypto::line_session::iv_size];
+
+    crypto::line_session_access::set_sent(line, UINT64_MAX - 1);
+    line.encrypt(data, data, sizeof(data), iv);
+    BOOST_CHECK_EQUAL(iv[4], 0xff);
+    BOOST_CHECK_EQUAL(iv[11], 0xfe);
+
+    // The counter stays at the limit instead of wrapping to packet zero.
+    for (int i = 0; i < 3; ++i) {
+        BOOST_CHECK_THROW(line.encrypt(data, data, sizeof(data), iv), std::runtime_error);
+    }
+    BOOST_CHECK_EQUAL(line.packets_sent(), UINT64_MAX);
+}
+
+BOOST_AUTO_TEST_CASE(steady_state_does_not_allocate)
+{
+    crypto::line_session a(random_bytes(32), random_bytes(16), random_bytes(16));
+    crypto::line_session b(random_bytes(32), random_bytes(16), random_bytes(16));
+
+    const size_t count = 16;
+    std::vector<unsigned char> text(count * 1400), wire(text.size()), back(text.size());
+    std::vector<unsigned char> ivs(count * crypto::line_session::iv_size);
+    std::vector<crypto::packet> packets(count);
+    crypto::fill_random(text);
+
+    size_t before = allocations;
+    for (size_t i = 0; i < count; ++i)
+    {
+        a.encrypt(&text[i * 1400], &wire[i * 1400], 1400, &ivs[i * crypto::line_session::iv_size]);
+        b.decrypt(&wire[i * 1400], &back[i * 1400], 1400, &ivs[i * crypto::line_session::iv_size]);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        packets[i] = crypto::packet{nullptr, &text[i * 1400], &wire[i * 1400], 1400, false};
+    }
+    BOOST_CHECK_EQUAL(a.encrypt(packets.data(), ivs.data(), count), count);
+    size_t after = allocations;
+
+    BOOST_CHECK_EQUAL(after - before, 0u);
+    BOOST_CHECK(packets[3].iv == &ivs[3 * crypto::line_session::iv_size]);
+}
@@ -0,0 +1,137 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_nacl_sign_key
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/sha256_hash.h"
+#include "arsenal/byte_array_wrap.h"
+#include "arsenal/flurry.h"
+#include "test_keys.h"
+
+using crypto::nacl_sign_key;
+
+BOOST_AUTO_TEST_CASE(sign_and_verify)
+{
+    nacl_sign_key key;
+    BOOST_CHECK(key.type() == crypto::sign_key::public_and_private);
+
+    byte_array digest = digest_of("hello world!");
+    byte_array signature = key.sign(digest);
+    BOOST_CHECK(signature.size() == nacl_sign_key::signature_size);
+    BOOST_CHECK(key.verify(digest, signature));
+
+    BOOST_CHECK(!key.verify(digest_of("hello world?"), signature));
+    byte_array bad = signature;
+    bad[10] ^= 1;
+    BOOST_CHECK(!key.verify(digest, bad));
+    BOOST_CHECK(!key.verify(digest, byte_array("short")));
+    BOOST_CHECK(!nacl_sign_key().verify(digest, signature));
+}
+
+BOOST_AUTO_TEST_CASE(serialisation)
+{
+    nacl_sign_key key;
+    byte_array digest = digest_of("serialise me");
+
+    nacl_sign_key restored(key.private_key());
+    BOOST_CHECK(restored.type() == crypto::sign_key::public_and_private);
+    BOOST_CHECK(restored.id() == key.id());
+    BOOST_CHECK(key.verify(digest, restored.sign(digest)));
+
+    nacl_sign_key verifier(key.public_key());
+    BOOST_CHECK(verifier.type() == crypto::sign_key::public_only);
+    BOOST_CHECK(verifier.id() == key.id());
+    BOOST_CHECK(verifier.verify(digest, key.sign(digest)));
+    BOOST_CHECK_THROW(verifier.sign(digest), std::runtime_error);
+
+    byte_array short_key;
+    {
+        byte_array_owrap<flurry::oarchive> write(short_key);
+        write.archive() << byte_array("too short") << false;
+    }
+    nacl_sign_key broken(short_key);
+    BOOST_CHECK(broken.type() == crypto::sign_key::invalid);
+    BOOST_CHECK_THROW(broken.sign(digest), std::runtime_error);
+    BOOST_CHECK(!broken.verify(digest, key.sign(digest)));
+
+    BOOST_CHECK(crypto::sign_key::ids({ &key, &verifier }) == std::vector<byte_array>(2, key.id()));
+}
+
+BOOST_AUTO_TEST_CASE(identity_is_cached)
+{
+    counting_key key;
+    byte_array const& id = key.id();
+    byte_array const& public_key = key.public_key();
+    BOOST_CHECK(id == crypto::sha256::to_byte_array(crypto::sha256::hash(public_key)));
+
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i) {
+                if (&key.id() != &id or &key.public_key() != &public_key) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    BOOST_CHECK(mismatches == 0);
+    BOOST_CHECK(key.encodes == 1);
+
+    // Fresh keys racing for their first id() still serialize once.
+    for (int round = 0; round < 20; ++round)
+    {
+        counting_key fresh;
+        std::thread a([&] { fresh.id(); });
+        std::thread b([&] { fresh.public_key(); });
+        fresh.id();
+        a.join();
+        b.join();
+        BOOST_CHECK(fresh.encodes == 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(batch_verification)
+{
+    // Three pieces of work in verify_batch(), the last one partial.
+    const size_t count = 40;
+    std::vector<std::unique_ptr<nacl_sign_key>> keys;
+    std::vector<byte_array> digests, signatures;
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (i < 10) {
+            keys.emplace_back(new nacl_sign_key);
+        }
+        digests.push_back(digest_of("packet " + std::to_string(i)));
+        signatures.push_back(keys[i % 10]->sign(digests.back()));
+    }
+    signatures[17][0] ^= 1;
+    signatures[33] = signatures[34];
+
+    std::vector<nacl_sign_key::signed_digest> items(count);
+    for (size_t i = 0; i < count; ++i) {
+        items[i] = { keys[i % 10].get(), &digests[i], &signatures[i], false };
+    }
+
+    BOOST_CHECK(nacl_sign_key::verify_batch(items.data(), count) == count - 2);
+
+    for (size_t i = 0; i < count; ++i) {
+        BOOST_CHECK(items[i].ok == (i != 17 and i != 33));
+    }
+    BOOST_CHECK(nacl_sign_key::verify_batch(items.data(), 0) == 0);
+    BOOST_CHECK(nacl_sign_key::verify_batch(items.data(), 3) == 3);
+}
@@ -0,0 +1,122 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_parallel_ctr
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+
+#include "krypto/krypto.h"
+#include "krypto/aes_128_ctr.h"
+#include "krypto/aes_256_ctr.h"
+#include "krypto/stream_cipher_xsalsa20.h"
+#include "krypto/parallel_ctr.h"
+
+namespace {
+
+template <typename Cipher>
+void check_matches_serial(unsigned char const* iv_bytes)
+{
+    std::vector<char> key(Cipher::key_size);
+    crypto::fill_random(key);
+    Cipher cipher(byte_array(key.data(), key.size()));
+
+    std::vector<unsigned char> iv(iv_bytes, iv_bytes + Cipher::iv_size);
+    crypto::thread_pool pool(3);
+
+    for (size_t size : { size_t(0), size_t(1), size_t(1000), size_t(4 << 20), size_t((4 << 20) + 13) })
+    {
+        std::vector<unsigned char> in(size), serial(size), parallel(size);
+        crypto::fill_random(in);
+        cipher.encrypt(in.data(), serial.data(), size, iv.data());
+
+        // Small segments so that even mid-sized buffers are split many ways.
+        crypto::parallel_ctr::encrypt(cipher, in.data(), parallel.data(), size, iv.data(), pool,
+                                      Cipher::block_size * 37);
+        BOOST_CHECK(serial == parallel);
+
+        crypto::parallel_ctr::encrypt(cipher, in, parallel, iv, pool);
+        BOOST_CHECK(serial == parallel);
+
+        crypto::parallel_ctr::decrypt(cipher, parallel.data(), parallel.data(), size, iv.data(), pool);
+        BOOST_CHECK(in == parallel);
+    }
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(thread_pool_runs_every_piece)
+{
+    crypto::thread_pool pool(4);
+    BOOST_CHECK_EQUAL(pool.concurrency(), 5u);
+
+    for (size_t count : { 0, 1, 2, 7, 1000 })
+    {
+        std::vector<std::atomic<int>> hits(count);
+        for (auto& h : hits) {
+            h = 0;
+        }
+        pool.parallel_for(count, [&](size_t i) { ++hits[i]; });
+        for (auto& h : hits) {
+            BOOST_CHECK_EQUAL(h.load(), 1);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(thread_pool_nested_job)
+{
+    crypto::thread_pool pool(4);
+    std::vector<std::atomic<int>> hits(8 * 8);
+    for (auto& h : hits) {
+        h = 0;
+    }
+    pool.parallel_for(8, [&](size_t i) {
+        pool.parallel_for(8, [&](size_t j) { ++hits[i * 8 + j]; });
+    });
+    for (auto& h : hits) {
+        BOOST_CHECK_EQUAL(h.load(), 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(aes_128_ctr_matches_serial)
+{
+    // Counter word close to wrapping, segments must wrap exactly like the serial path.
+    unsigned char iv[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 0xff, 0xff, 0xf0, 0x00};
+    check_matches_serial<crypto::aes_128_ctr>(iv);
+}
+
+BOOST_AUTO_TEST_CASE(aes_256_ctr_matches_serial)
+{
+    // Carry must ripple into the upper 64 bits of the counter.
+    unsigned char iv[16] = {1, 2, 3, 4, 5, 6, 7, 8, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xf0, 0x00};
+    check_matches_serial<crypto::aes_256_ctr>(iv);
+}
+
+BOOST_AUTO_TEST_CASE(xsalsa20_matches_serial)
+{
+    unsigned char iv[24];
+    crypto::fill_random(iv);
+    check_matches_serial<crypto::xsalsa20>(iv);
+}
+
+BOOST_AUTO_TEST_CASE(in_place_round_trip)
+{
+    std::vector<char> key(crypto::aes_256_ctr::key_size);
+    crypto::block iv;
+    crypto::fill_random(key);
+    crypto::fill_random(iv);
+    crypto::aes_256_ctr aes(byte_array(key.data(), key.size()));
+
+    std::vector<unsigned char> data((1 << 20) + 13);
+    crypto::fill_random(data);
+    std::vector<unsigned char> original(data);
+
+    aes.encrypt(data.data(), data.data(), data.size(), iv.data());
+    BOOST_CHECK(data != original);
+    crypto::parallel_ctr::encrypt(aes, data.data(), data.data(), data.size(), iv.data());
+    BOOST_CHECK(data == original);
+}
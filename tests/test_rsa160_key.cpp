@@ -0,0 +1,216 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_rsa160_key
+// The tests cross-check against OpenSSL's own, deprecated, RSA calls.
+#define OPENSSL_SUPPRESS_DEPRECATED
+#include <boost/test/unit_test.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <openssl/obj_mac.h>
+#include <openssl/rsa.h>
+
+#include "krypto/krypto.h"
+#include "krypto/rsa160_key.h"
+#include "krypto/sha256_hash.h"
+#include "krypto/utils.h"
+#include "arsenal/byte_array_wrap.h"
+#include "arsenal/flurry.h"
+
+using crypto::rsa160_key;
+
+namespace {
+
+byte_array digest_of(std::string const& text)
+{
+    return crypto::sha256::to_byte_array(crypto::sha256::hash(byte_array(text)));
+}
+
+// 1024-bit key and RSASSA-PKCS1-v1_5 SHA-256 signature of "rsa160_key test vector",
+// made with "openssl genpkey" and "openssl dgst -sha256 -sign".
+char const* const vector_n =
+    "c0c68f6c04e6545419c10941dff3d6bd60afb205ec01edbb1a8d9b9ad814a4ef"
+    "650437aa9af2d4175b623ba4065399839fa6d0a250bfa00095f196bc0d33a71b"
+    "a48f00724342134b2d2b3cd308e274484db34e2c6553ad1b6b2b668393328a44"
+    "c0ced43fc0320b8c10164d1aac4f61405905ff461223e4464fc5f16a2be6f4b7";
+char const* const vector_e = "010001";
+char const* const vector_d =
+    "6bd5a69cd210d5d345a4c9bce3bdcebd98bc2f6548a3bb8c124a6c64adc2be90"
+    "7b7d647636bee70d39bd35878752746940815bebb027c12512bb558a540834cd"
+    "3505e1f31d23ea3578cbb09e9783290cdca5c7d7f6019692f8daee9cf20fc4cf"
+    "5ad0aa33ddca6ad32c79db98ced012372bb24a578fd67927fd6f1fcf6d2c73c1";
+char const* const vector_p =
+    "e6ac8916b0d4483cb1df557516008aa83cd59f698bbfde1d6a2ae83bd8550cbb"
+    "d27ad7d8ec2adfc40c1c519f052e79eedbfc176016cf4f7dbde1e10a150b4adf";
+char const* const vector_q =
+    "d5f0d4a5117ffb506188e5ed2f5801b3e9f7359b3a9a821e535c7346947b2d26"
+    "d5cda6f3f14900d692bb46125be68bb49b6415ce64420e1aba910a52fb6de929";
+char const* const vector_dmp1 =
+    "90fa83b6d530b6ae1f05450aafe76b3e4deddda1528a26a9ca1e6993a365e0f8"
+    "f352edf2928c67d329e16a934d88666e6fa8c3704b25c4ca3cdb88baf37b0375";
+char const* const vector_dmq1 =
+    "d02c291dfdab44c570429f486ddafabd301a0625679ed4a1e18781fbd99b09d2"
+    "52146c31ce44b4f6158cf8a000a092ac48cfd8901dea50831daae81adae09611";
+char const* const vector_iqmp =
+    "d78449002ad675fa38b513959e672feb77183360e96db2225b0368521a148247"
+    "9f7964ea4c920df5157210896510d5c0873a977aa78ac670515fed0553525e80";
+char const* const vector_signature =
+    "ba26c25c404f04308895c2a30c63566648d98a8399ccd8f7e0fd519f753c0213"
+    "2574ffa01614d972131d770e3cd7fe193dfe85c2a9ba75efd18970eaa0ba5d2e"
+    "23d8bcbd6d09c71263ade3e348f22edfe122f0ebe335e0bee774e68ba1afdb49"
+    "cf75ba7fa46a836637998b90b17ceff7241f3777bd8a291d49a8d7c9f97665a1";
+
+byte_array from_hex(char const* hex)
+{
+    BIGNUM* bn = nullptr;
+    BN_hex2bn(&bn, hex);
+    byte_array ba = crypto::utils::bn2ba(bn);
+    BN_free(bn);
+    return ba;
+}
+
+/// rsa160_key serialization of the given fields, in its own order.
+byte_array key_blob(std::vector<char const*> const& hex, bool with_private)
+{
+    byte_array data;
+    {
+        byte_array_owrap<flurry::oarchive> write(data);
+        write.archive() << from_hex(hex[0]) << from_hex(hex[1]) << with_private;
+        for (size_t i = 2; i < hex.size(); ++i) {
+            write.archive() << from_hex(hex[i]);
+        }
+    }
+    return data;
+}
+
+byte_array vector_key()
+{
+    return key_blob({ vector_n, vector_e, vector_d, vector_p, vector_q,
+                      vector_dmp1, vector_dmq1, vector_iqmp }, true);
+}
+
+/// OpenSSL's own RSA object for a serialized rsa160_key.
+RSA* openssl_key(byte_array const& blob)
+{
+    BIGNUM *n = nullptr, *e = nullptr, *d = nullptr, *p = nullptr, *q = nullptr;
+    BIGNUM *dmp1 = nullptr, *dmq1 = nullptr, *iqmp = nullptr;
+    bool has_private_key = false;
+    byte_array_iwrap<flurry::iarchive> read(blob);
+    read.archive() >> n >> e >> has_private_key;
+    RSA* rsa = RSA_new();
+    RSA_set0_key(rsa, n, e, nullptr);
+    if (has_private_key)
+    {
+        read.archive() >> d >> p >> q >> dmp1 >> dmq1 >> iqmp;
+        RSA_set0_key(rsa, nullptr, nullptr, d);
+        RSA_set0_factors(rsa, p, q);
+        RSA_set0_crt_params(rsa, dmp1, dmq1, iqmp);
+    }
+    return rsa;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(known_answer)
+{
+    rsa160_key key(vector_key());
+    BOOST_REQUIRE(key.type() == crypto::sign_key::public_and_private);
+    BOOST_CHECK(key.id().size() == 160/8);
+
+    byte_array digest = digest_of("rsa160_key test vector");
+    byte_array expected = from_hex(vector_signature);
+    // PKCS#1 v1.5 is deterministic, blinding must not show.
+    for (int i = 0; i < 40; ++i) {
+        BOOST_CHECK(key.sign(digest) == expected);
+    }
+    BOOST_CHECK(key.verify(digest, expected));
+    BOOST_CHECK(!key.verify(digest_of("rsa160_key test vector?"), expected));
+
+    rsa160_key verifier(key.public_key());
+    BOOST_CHECK(verifier.type() == crypto::sign_key::public_only);
+    BOOST_CHECK(verifier.id() == key.id());
+    BOOST_CHECK(verifier.verify(digest, expected));
+    BOOST_CHECK_THROW(verifier.sign(digest), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(openssl_interoperates)
+{
+    rsa160_key key(2048);
+    BOOST_REQUIRE(key.type() == crypto::sign_key::public_and_private);
+    RSA* rsa = openssl_key(key.private_key());
+
+    for (int i = 0; i < 8; ++i)
+    {
+        byte_array digest = digest_of("message " + std::to_string(i));
+        byte_array signature = key.sign(digest);
+        BOOST_CHECK(signature.size() == 256);
+        BOOST_CHECK(RSA_verify(NID_sha256, (unsigned char const*)digest.const_data(), digest.size(),
+                               (unsigned char const*)signature.const_data(), signature.size(), rsa) == 1);
+
+        byte_array theirs;
+        theirs.resize(RSA_size(rsa));
+        unsigned int size = 0;
+        BOOST_REQUIRE(RSA_sign(NID_sha256, (unsigned char const*)digest.const_data(), digest.size(),
+                               (unsigned char*)theirs.data(), &size, rsa) == 1);
+        BOOST_CHECK(theirs == signature);
+        BOOST_CHECK(key.verify(digest, theirs));
+    }
+    RSA_free(rsa);
+
+    rsa160_key restored(key.private_key());
+    byte_array digest = digest_of("restored");
+    BOOST_CHECK(key.verify(digest, restored.sign(digest)));
+}
+
+BOOST_AUTO_TEST_CASE(malformed_keys_are_invalid)
+{
+    byte_array digest = digest_of("nothing");
+    byte_array truncated = vector_key();
+    truncated.resize(truncated.size() / 2);
+
+    std::vector<byte_array> bad = {
+        byte_array(),
+        truncated,
+        key_blob({ vector_n, vector_e, vector_d, vector_p, vector_q,
+                   vector_dmp1, vector_dmq1, "00" }, true),         // zero iqmp
+        key_blob({ vector_n, vector_e, vector_d, vector_q, vector_q,
+                   vector_dmp1, vector_dmq1, vector_iqmp }, true),  // p q != n
+        key_blob({ "00", vector_e }, false),                        // zero modulus
+        key_blob({ vector_n, "02" }, false),                        // even exponent
+    };
+    for (byte_array const& blob : bad)
+    {
+        rsa160_key key(blob);
+        BOOST_CHECK(key.type() == crypto::sign_key::invalid);
+        BOOST_CHECK_THROW(key.sign(digest), std::runtime_error);
+        BOOST_CHECK(!key.verify(digest, from_hex(vector_signature)));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_signing)
+{
+    rsa160_key key(vector_key());
+    byte_array expected = from_hex(vector_signature);
+    byte_array digest = digest_of("rsa160_key test vector");
+
+    std::vector<std::thread> threads;
+    std::atomic<int> good{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 50; ++i) {
+                good += key.sign(digest) == expected;
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    BOOST_CHECK(good == 200);
+}
@@ -0,0 +1,102 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_sha256_batch
+#include <boost/test/unit_test.hpp>
+#include <memory>
+
+#include "krypto/krypto.h"
+#include "krypto/dispatch.h"
+#include "krypto/sha256_hash.h"
+#include "krypto/sign_key.h"
+#include "test_keys.h"
+
+using namespace crypto::dispatch;
+
+namespace {
+
+const impl batch_impls[] = { impl::portable, impl::avx2, impl::avx512 };
+
+// Lengths around the padding boundaries, in an order that keeps lanes out of step.
+const size_t lengths[] = { 0, 1, 55, 56, 63, 64, 119, 1000, 3, 128, 120, 65, 300, 2, 64, 0, 191 };
+
+std::vector<byte_array> random_messages(size_t count)
+{
+    std::vector<byte_array> messages;
+    for (size_t i = 0; i < count; ++i)
+    {
+        byte_array m;
+        m.resize(lengths[i % (sizeof(lengths)/sizeof(lengths[0]))]);
+        crypto::fill_random(m.as_vector());
+        messages.push_back(m);
+    }
+    return messages;
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(known_answer)
+{
+    std::vector<byte_array> messages = { byte_array(), byte_array("abc") };
+    std::vector<crypto::sha256::digest> digests = crypto::sha256::hash_batch(messages);
+
+    BOOST_REQUIRE(digests.size() == 2);
+    BOOST_CHECK(digests[0] == crypto::sha256::hash(byte_array()));
+    BOOST_CHECK(digests[1][0] == 0xba and digests[1][1] == 0x78 and digests[1][31] == 0xad);
+}
+
+BOOST_AUTO_TEST_CASE(lanes_match_single_hash)
+{
+    impl original = selected(primitive::sha256_batch);
+
+    // Counts that leave some lanes idle as well as exact multiples of 8 and 16.
+    for (size_t count : { 1, 5, 8, 13, 16, 17, 40 })
+    {
+        std::vector<byte_array> messages = random_messages(count);
+
+        for (impl i : batch_impls)
+        {
+            if (!force(primitive::sha256_batch, i)) {
+                continue;
+            }
+            std::vector<crypto::sha256::digest> digests = crypto::sha256::hash_batch(messages);
+            BOOST_REQUIRE(digests.size() == count);
+            for (size_t k = 0; k < count; ++k) {
+                BOOST_CHECK_MESSAGE(digests[k] == crypto::sha256::hash(messages[k]),
+                    name(i) << " message " << k << " of " << messages[k].size() << " bytes");
+            }
+        }
+    }
+
+    force(primitive::sha256_batch, original);
+}
+
+BOOST_AUTO_TEST_CASE(key_ids)
+{
+    std::vector<std::unique_ptr<blob_key>> keys;
+    std::vector<crypto::sign_key const*> pointers;
+    for (byte_array const& blob : random_messages(11))
+    {
+        keys.emplace_back(new blob_key(blob, 160/8));
+        pointers.push_back(keys.back().get());
+    }
+
+    // Let one key compute its id() alone first.
+    byte_array first = keys[0]->id();
+
+    std::vector<byte_array> ids = crypto::sign_key::ids(pointers);
+    BOOST_REQUIRE(ids.size() == keys.size());
+    BOOST_CHECK(ids[0] == first);
+    for (size_t i = 0; i < keys.size(); ++i)
+    {
+        byte_array expected = crypto::sha256::to_byte_array(crypto::sha256::hash(keys[i]->public_key()));
+        expected.resize(160/8);
+        BOOST_CHECK(ids[i] == expected);
+        BOOST_CHECK(keys[i]->id() == expected);
+    }
+}
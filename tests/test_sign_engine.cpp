@@ -0,0 +1,169 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_sign_engine
+#include <boost/test/unit_test.hpp>
+#include <functional>
+#include <future>
+#include <stdexcept>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/sha256_hash.h"
+#include "krypto/sign_engine.h"
+#include "test_keys.h"
+
+using crypto::sign_engine;
+using crypto::nacl_sign_key;
+
+namespace {
+
+/// Calls @a fn when asked to sign, to run code on an engine worker.
+class callback_key : public echo_signer
+{
+    std::function<void()> fn_;
+
+public:
+    explicit callback_key(std::function<void()> fn)
+        : fn_(std::move(fn))
+    {}
+
+    byte_array sign(byte_array const& digest) const override
+    {
+        fn_();
+        return digest;
+    }
+};
+
+/// Holds every signature back until @a gate is set, keeping its worker busy.
+class gated_key : public echo_signer
+{
+    std::shared_future<void> gate_;
+
+public:
+    explicit gated_key(std::shared_future<void> gate)
+        : gate_(std::move(gate))
+    {}
+
+    byte_array sign(byte_array const& digest) const override
+    {
+        gate_.wait();
+        return digest;
+    }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(futures)
+{
+    auto key = std::make_shared<nacl_sign_key>();
+    sign_engine engine(2);
+
+    std::vector<std::future<byte_array>> signatures;
+    for (int i = 0; i < 20; ++i) {
+        signatures.push_back(engine.sign(key, digest_of(std::to_string(i))));
+    }
+
+    std::vector<std::future<bool>> results;
+    for (int i = 0; i < 20; ++i)
+    {
+        byte_array signature = signatures[i].get();
+        BOOST_CHECK(key->verify(digest_of(std::to_string(i)), signature));
+        results.push_back(engine.verify(key, digest_of(std::to_string(i ^ (i == 7))), signature));
+    }
+    for (int i = 0; i < 20; ++i) {
+        BOOST_CHECK(results[i].get() == (i != 7));
+    }
+
+    auto failing = std::make_shared<echo_signer>();
+    BOOST_CHECK_THROW(engine.sign(failing, byte_array()).get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(handlers_run_on_io_service)
+{
+    auto key = std::make_shared<nacl_sign_key>();
+    boost::asio::io_service io;
+    boost::asio::io_service::work work(io);
+    std::thread::id io_thread = std::this_thread::get_id();
+
+    int signed_count = 0, verified_count = 0;
+    sign_engine engine(3);
+    byte_array digest = digest_of("open");
+
+    for (int i = 0; i < 10; ++i)
+    {
+        engine.async_sign(key, digest, io, [&](byte_array const& signature) {
+            BOOST_CHECK(std::this_thread::get_id() == io_thread);
+            BOOST_CHECK(signature.size() == nacl_sign_key::signature_size);
+            engine.async_verify(key, digest, signature, io, [&](bool valid) {
+                BOOST_CHECK(valid);
+                if (++verified_count == 10) {
+                    io.stop();
+                }
+            });
+            ++signed_count;
+        });
+    }
+    engine.async_sign(std::make_shared<echo_signer>(), byte_array(), io, [&](byte_array const& s) {
+        BOOST_CHECK(s.size() == 0);
+    });
+
+    io.run();
+    BOOST_CHECK(signed_count == 10);
+    BOOST_CHECK(verified_count == 10);
+}
+
+BOOST_AUTO_TEST_CASE(stealing_and_stats)
+{
+    std::promise<void> open;
+    auto gated = std::make_shared<gated_key>(open.get_future().share());
+    std::vector<std::future<byte_array>> results;
+    {
+        sign_engine engine(4);
+        BOOST_CHECK(engine.threads() == 4);
+
+        // Jobs submitted from a worker all land on its own queue. That worker blocks on
+        // the first one, so the rest only start once the idle workers steal them.
+        auto spawner = std::make_shared<callback_key>([&] {
+            for (int i = 0; i < 16; ++i) {
+                results.push_back(engine.sign(gated, digest_of(std::to_string(i))));
+            }
+        });
+        engine.sign(spawner, digest_of("spawn")).get();
+        BOOST_REQUIRE(results.size() == 16);
+        BOOST_CHECK(engine.queue_depth() <= 16);
+
+        // The deadline only keeps a broken engine from hanging the test.
+        auto deadline = sign_engine::clock::now() + std::chrono::seconds(30);
+        while (engine.stolen() == 0 and sign_engine::clock::now() < deadline) {
+            std::this_thread::yield();
+        }
+        BOOST_CHECK(engine.stolen() > 0);
+        open.set_value();
+        for (int i = 0; i < 16; ++i) {
+            BOOST_CHECK(results[i].get() == digest_of(std::to_string(i)));
+        }
+
+        // Statistics are updated just after a job hands over its result.
+        while (engine.completed() < 17) {
+            std::this_thread::yield();
+        }
+        BOOST_CHECK(engine.completed() == 17);
+        BOOST_CHECK(engine.queue_depth() == 0);
+        BOOST_CHECK(engine.max_latency() >= engine.average_latency());
+
+        // Queued jobs still run when the engine goes away.
+        results.clear();
+        for (int i = 0; i < 8; ++i) {
+            results.push_back(engine.sign(gated, digest_of("late")));
+        }
+    }
+    for (auto& r : results) {
+        BOOST_CHECK(r.get() == digest_of("late"));
+    }
+}
@@ -0,0 +1,118 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_tree_hash
+#include <boost/test/unit_test.hpp>
+#include <algorithm>
+
+#include "krypto/krypto.h"
+#include "krypto/tree_hash.h"
+
+using namespace crypto;
+using tree_hash::digest;
+
+namespace {
+
+std::vector<unsigned char> random_bytes(size_t size)
+{
+    std::vector<unsigned char> data(size);
+    fill_random(data);
+    return data;
+}
+
+// RFC 6962 MTH, splitting at the largest power of two below n.
+digest reference_root(std::vector<digest> const& leaves, size_t begin, size_t end)
+{
+    size_t n = end - begin;
+    if (n == 1) {
+        return leaves[begin];
+    }
+    size_t k = 1;
+    while (k * 2 < n) {
+        k *= 2;
+    }
+    return tree_hash::node(reference_root(leaves, begin, begin + k),
+                           reference_root(leaves, begin + k, end));
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(format)
+{
+    unsigned char const text[] = "abc";
+    sha256::context ctx;
+    ctx.update("\0abc", 4);
+    BOOST_CHECK(tree_hash::leaf(text, 3) == ctx.finalize());
+
+    // Small data is a single chunk, and the root is that leaf.
+    BOOST_CHECK(tree_hash::hash(text, 3) == tree_hash::leaf(text, 3));
+    BOOST_CHECK(tree_hash::hash(nullptr, 0) == tree_hash::leaf(nullptr, 0));
+
+    std::vector<unsigned char> data = random_bytes(3 * 1000 + 1);
+    digest expected = tree_hash::node(
+        tree_hash::node(tree_hash::leaf(&data[0], 1000), tree_hash::leaf(&data[1000], 1000)),
+        tree_hash::node(tree_hash::leaf(&data[2000], 1000), tree_hash::leaf(&data[3000], 1)));
+    BOOST_CHECK(tree_hash::hash(data.data(), data.size(), 1000) == expected);
+}
+
+BOOST_AUTO_TEST_CASE(matches_rfc6962_shape)
+{
+    for (size_t count = 1; count <= 33; ++count)
+    {
+        std::vector<unsigned char> data = random_bytes(count * 64 - 7);
+        std::vector<digest> leaves = tree_hash::leaves(data.data(), data.size(), 64);
+        BOOST_REQUIRE(leaves.size() == count);
+        BOOST_CHECK(tree_hash::root(leaves) == reference_root(leaves, 0, count));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(parallel_matches_serial)
+{
+    std::vector<unsigned char> data = random_bytes(2 * 1024 * 1024 + 12345);
+    thread_pool pool(3);
+    std::vector<digest> leaves = tree_hash::leaves(data.data(), data.size(), 64 * 1024, pool);
+    BOOST_REQUIRE(leaves.size() == 33);
+    for (size_t i = 0; i < leaves.size(); ++i)
+    {
+        size_t offset = i * 64 * 1024;
+        BOOST_CHECK(leaves[i] == tree_hash::leaf(&data[offset],
+                                                 std::min<size_t>(64 * 1024, data.size() - offset)));
+    }
+
+    BOOST_CHECK(tree_hash::hash(data.data(), data.size())
+                == tree_hash::root(tree_hash::leaves(data.data(), data.size())));
+}
+
+BOOST_AUTO_TEST_CASE(audit_paths)
+{
+    for (size_t count : { 1, 2, 3, 5, 8, 13 })
+    {
+        std::vector<unsigned char> data = random_bytes(count * 100);
+        std::vector<digest> leaves = tree_hash::leaves(data.data(), data.size(), 100);
+        digest root = tree_hash::root(leaves);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            std::vector<digest> path = tree_hash::proof(leaves, i);
+            BOOST_CHECK(tree_hash::verify(leaves[i], i, count, path, root));
+            BOOST_CHECK(!tree_hash::verify(leaves[i], count, count, path, root));
+            if (!path.empty())
+            {
+                std::vector<digest> shorter(path.begin(), path.end() - 1);
+                BOOST_CHECK(!tree_hash::verify(leaves[i], i, count, shorter, root));
+            }
+
+            digest bad = leaves[i];
+            bad[0] ^= 1;
+            BOOST_CHECK(!tree_hash::verify(bad, i, count, path, root));
+            if (count > 1) {
+                BOOST_CHECK(!tree_hash::verify(leaves[i], (i + 1) % count, count, path, root));
+            }
+        }
+    }
+}
@@ -0,0 +1,122 @@
+//
+// Part of Metta OS. Check http://atta-metta.net for latest version.
+//
+// Copyright 2007 - 2014, Stanislav Karchebnyy <berkus@atta-metta.net>
+//
+// Distributed under the Boost Software License, Version 1.0.
+// (See file LICENSE_1_0.txt or a copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+#define BOOST_TEST_MODULE Test_verify_cache
+#include <boost/test/unit_test.hpp>
+#include <thread>
+
+#include "krypto/krypto.h"
+#include "krypto/crypto_box_sign.h"
+#include "krypto/verify_cache.h"
+#include "test_keys.h"
+
+using crypto::verify_cache;
+
+BOOST_AUTO_TEST_CASE(retransmits_hit)
+{
+    counting_key key;
+    verify_cache cache(16);
+    byte_array digest = digest_of("open packet");
+    byte_array signature = key.sign(digest);
+
+    for (int i = 0; i < 5; ++i) {
+        BOOST_CHECK(cache.verify(key, digest, signature));
+    }
+    BOOST_CHECK(key.verifies == 1);
+    BOOST_CHECK(cache.hits() == 4);
+    BOOST_CHECK(cache.misses() == 1);
+
+    // Failures are never cached.
+    byte_array bad = signature;
+    bad[0] ^= 1;
+    BOOST_CHECK(!cache.verify(key, digest, bad));
+    BOOST_CHECK(!cache.verify(key, digest, bad));
+    BOOST_CHECK(key.verifies == 3);
+    BOOST_CHECK(cache.size() == 1);
+
+    // Same signature under a different key or digest is a different entry.
+    counting_key other;
+    BOOST_CHECK(!cache.verify(other, digest, signature));
+    BOOST_CHECK(!cache.verify(key, digest_of("open packet?"), signature));
+}
+
+BOOST_AUTO_TEST_CASE(capacity)
+{
+    counting_key key;
+    // Long enough that nothing expires while the test runs.
+    verify_cache cache(3, std::chrono::seconds(30));
+    std::vector<byte_array> digests, signatures;
+    for (int i = 0; i < 4; ++i)
+    {
+        digests.push_back(digest_of("packet " + std::to_string(i)));
+        signatures.push_back(key.sign(digests.back()));
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        cache.verify(key, digests[i], signatures[i]);
+    }
+    cache.verify(key, digests[0], signatures[0]);   // 0 becomes most recent
+    cache.verify(key, digests[3], signatures[3]);   // evicts 1
+    BOOST_CHECK(cache.size() == 3);
+
+    int before = key.verifies;
+    cache.verify(key, digests[0], signatures[0]);
+    BOOST_CHECK(key.verifies == before);
+    cache.verify(key, digests[1], signatures[1]);
+    BOOST_CHECK(key.verifies == before + 1);
+
+    cache.clear();
+    BOOST_CHECK(cache.size() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(ttl)
+{
+    counting_key key;
+    verify_cache cache(3, std::chrono::milliseconds(20));
+    byte_array digest = digest_of("packet");
+    byte_array signature = key.sign(digest);
+
+    BOOST_CHECK(cache.verify(key, digest, signature));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    // Sleeping can only overshoot, so the entry is always stale by now.
+    int before = key.verifies;
+    BOOST_CHECK(cache.verify(key, digest, signature));
+    BOOST_CHECK(key.verifies == before + 1);
+}
+
+BOOST_AUTO_TEST_CASE(concurrent_use)
+{
+    counting_key key;
+    verify_cache cache(64);
+    std::vector<byte_array> digests, signatures;
+    for (int i = 0; i < 100; ++i)
+    {
+        digests.push_back(digest_of("storm " + std::to_string(i)));
+        signatures.push_back(key.sign(digests.back()));
+    }
+
+    std::vector<std::thread> threads;
+    std::atomic<int> failures{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t] {
+            for (int round = 0; round < 200; ++round) {
+                size_t i = (round * 7 + t) % digests.size();
+                if (!cache.verify(key, digests[i], signatures[i])) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    BOOST_CHECK(failures == 0);
+    BOOST_CHECK(cache.hits() + cache.misses() == 800);
+    BOOST_CHECK(cache.size() <= 64);
+}